@@ -7,8 +7,21 @@
 #include "./utils/texture.h"
 #include "./utils/shader.h"
 #include "./utils/camera.h"
+#include "./utils/rtin.h"
+#include "./utils/mesh_optimizer.h"
+#include "./utils/tile_codec.h"
+#include "./utils/heightfield.h"
+#include "./utils/stream_buffer.h"
+#include "./utils/tile_prefetcher.h"
+#include "./utils/scatter.h"
+#include "./utils/scatter_renderer.h"
+#include "./utils/volume.h"
+#include "./utils/clipmap.h"
 #include <math.h>
 #include <vector> // Make sure to include vector
+#include <memory>
+#include <future>
+#include <unordered_map>
 #include "SFML/Graphics.hpp"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -21,8 +34,37 @@ int Perlin::p[Perlin::GRADIENT_COUNT * 2];
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
-const unsigned int NUM_STRIPS = 400 - 1;
-const unsigned int NUM_VERTS_PER_STRIP = 400 * 2;
+// store heights as uint16 with a per-tile scale/offset instead of float XYZ (1/6 the vertex data)
+const bool QUANTIZED_HEIGHTS = true;
+// quantized mode: load the 400 x 400 map from this TileCodec file if there is one, else generate it and
+// save it there; empty generates a new map every run
+const char* const TERRAIN_FILE = "";
+// > 0: draw an RTIN-simplified triangle list within this vertical error instead of the full grid
+const float SIMPLIFY_MAX_ERROR = 0.0f;
+// cells per strip column block; 400 - 1 gives the plain row-by-row strips
+const int STRIP_BLOCK_WIDTH = MeshOptimizer::stripBlockWidth();
+// rebuild the shader program when vertex.vs / fragment.fs change on disk
+const bool HOT_RELOAD_SHADERS = false;
+// the camera is kept at least this far above the terrain surface
+const float CAMERA_GROUND_CLEARANCE = 1.0f;
+// R regenerates the grid terrain at runtime, streamed through a StreamBuffer ring
+const bool STREAM_TERRAIN_UPDATES = true;
+// draw an unbounded world of TILE_CELLS-wide tiles, generated ahead of the camera, instead of the 400 x 400 map
+const bool TILED_TERRAIN = false;
+const int TILE_CELLS = 64;
+// Poisson-disk scattered objects (see scatter.h) on the 400 x 400 map, drawn instanced
+const bool SCATTER_INSTANCES = true;
+// scattered objects thin out beyond this distance (0 draws all of them)
+const float SCATTER_FULL_DENSITY_DISTANCE = 10.0f;
+// draw a mesh of a 3D density volume (overhangs and caves, see volume.h) instead of the height map
+const bool VOLUMETRIC_TERRAIN = false;
+// draw an unbounded world as a geometry clipmap (see clipmap.h): CLIPMAP_LEVELS nested grids of
+// CLIPMAP_SIZE samples around the camera, streamed into fixed-size textures as it moves
+const bool CLIPMAP_TERRAIN = false;
+const int CLIPMAP_LEVELS = 6;
+const int CLIPMAP_SIZE = 256;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
 
 Camera camera(glm::vec3(0.0f, 19.0f, 59.0f));
 float lastX = SCR_WIDTH / 2.0f;
@@ -71,6 +113,8 @@ int main()
     glEnable(GL_DEPTH_TEST);
 
     Shader shader("vertex.vs", "fragment.fs");
+    if (HOT_RELOAD_SHADERS)
+        shader.watchFiles();
 
     /*float quadVertices[] = {
         // positions     // texCoords
@@ -85,9 +129,89 @@ int main()
         0, 2, 3
     };*/
 
-    std::vector<float> textureData = perlin.generateHeightMap(400, 400, 400);
-    unsigned int heightmapID = Texture().generate2DArray(textureData, 400, 400);
-    std::vector<unsigned int> indices = perlin.generateHeightMapIndices(400, 400);
+    const bool simplified = SIMPLIFY_MAX_ERROR > 0.0f;
+    const bool clipmapped = CLIPMAP_TERRAIN && !TILED_TERRAIN;
+    const bool volumetric = VOLUMETRIC_TERRAIN && !TILED_TERRAIN && !clipmapped;
+    // the simplified and volume meshes are float XYZ triangle lists rather than the grid's strips
+    const bool triangleList = simplified || volumetric;
+    const bool quantized = QUANTIZED_HEIGHTS && !triangleList;
+
+    std::vector<float> textureData;
+    QuantizedHeightMap quantizedData;
+    unsigned int heightmapID = 0;
+    if (quantized) {
+        bool loaded = false;
+        if (TERRAIN_FILE[0] != '\0' && std::ifstream(TERRAIN_FILE).good()) {
+            try {
+                quantizedData = TileCodec::load(TERRAIN_FILE);
+                loaded = quantizedData.width == 400 && quantizedData.length == 400;
+                if (!loaded)
+                    std::cout << "Ignoring " << TERRAIN_FILE << ": not a 400 x 400 map" << std::endl;
+            }
+            catch (const std::exception& e) {
+                std::cout << "Failed to load " << TERRAIN_FILE << ": " << e.what() << std::endl;
+            }
+        }
+        if (!loaded) {
+            quantizedData = perlin.generateQuantizedHeightMap(400, 400, 400);
+            if (TERRAIN_FILE[0] != '\0') {
+                try {
+                    TileCodec::save(quantizedData, TERRAIN_FILE);
+                }
+                catch (const std::exception& e) {
+                    std::cout << "Failed to save " << TERRAIN_FILE << ": " << e.what() << std::endl;
+                }
+            }
+        }
+        heightmapID = Texture().generate2DArray(quantizedData);
+    }
+    else if (!volumetric) { // the volume mesh is generated on its own below
+        textureData = perlin.generateHeightMap(400, 400, 400);
+        heightmapID = Texture().generate2DArray(textureData, 400, 400);
+    }
+    // CPU-side copy of the surface for height queries (taken before simplification replaces textureData);
+    // none for the volume, which has no single height at an (x, z)
+    std::unique_ptr<HeightField> terrain;
+    if (!volumetric)
+        terrain.reset(new HeightField(quantized ? HeightField::fromQuantized(quantizedData) : HeightField::fromHeightMap(textureData, 400, 400)));
+    ScatterSettings scatterSettings;
+    scatterSettings.radius = 0.3f;
+    scatterSettings.minHeight = 2.0f;
+    scatterSettings.maxHeight = 12.0f;
+    scatterSettings.maxSlope = 0.7f;
+    scatterSettings.minScale = 0.2f;
+    scatterSettings.maxScale = 0.5f;
+    const bool scattered = SCATTER_INSTANCES && !TILED_TERRAIN && !volumetric && !clipmapped;
+    std::unique_ptr<ScatterRenderer> scatterRenderer;
+    std::unique_ptr<Shader> instanceShader;
+    if (scattered) {
+        ScatterInstances instances = PoissonScatter::generate(*terrain, scatterSettings);
+        std::cout << "Scattered " << instances.size() << " instances\n";
+        scatterRenderer.reset(new ScatterRenderer(instances));
+        instanceShader.reset(new Shader("instance.vs", "instance.fs"));
+        if (HOT_RELOAD_SHADERS)
+            instanceShader->watchFiles();
+    }
+    std::vector<unsigned int> indices;
+    if (volumetric) {
+        VolumeMesh mesh = DensityVolume(VolumeSettings()).mesh();
+        std::cout << "Volume terrain: " << mesh.surfaceBricks << " of " << mesh.bricks << " bricks meshed, "
+            << mesh.triangleCount() << " triangles, " << mesh.vertexCount() << " vertices\n";
+        textureData.swap(mesh.vertices);
+        indices.swap(mesh.indices);
+    }
+    else if (simplified) {
+        TerrainMesh mesh = Rtin(textureData, 400, 400).getMesh(SIMPLIFY_MAX_ERROR);
+        MeshOptimizer::optimizeVertexCache(mesh.indices, mesh.vertexCount());
+        MeshOptimizer::optimizeVertexFetch(mesh.vertices, mesh.indices);
+        std::cout << "Simplified terrain: " << mesh.triangleCount() << " triangles, " << mesh.vertexCount() << " vertices\n";
+        textureData.swap(mesh.vertices);
+        indices.swap(mesh.indices);
+        VertexCacheStats cacheStats = MeshOptimizer::analyzeVertexCache(indices, textureData.size() / 3, MeshOptimizer::CACHE_SIZE);
+        std::cout << "Index buffer ACMR " << cacheStats.acmr << ", ATVR " << cacheStats.atvr << "\n";
+    }
+    // the grid's strip indices are written straight into the mapped element buffer below
+    const size_t indexCount = triangleList ? indices.size() : Perlin::heightMapIndexCount(400, 400, STRIP_BLOCK_WIDTH);
 
     unsigned int VBO, VAO, EBO;
 
@@ -97,16 +221,126 @@ int main()
     glGenBuffers(1, &EBO);
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, textureData.size() * sizeof(float), textureData.data(), GL_STATIC_DRAW);
+    if (quantized)
+        glBufferData(GL_ARRAY_BUFFER, quantizedData.heights.size() * sizeof(uint16_t), quantizedData.heights.data(), GL_STATIC_DRAW);
+    else
+        glBufferData(GL_ARRAY_BUFFER, textureData.size() * sizeof(float), textureData.data(), GL_STATIC_DRAW);
     
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    if (triangleList) {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    }
+    else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+        void* mapped = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, indexCount * sizeof(unsigned int),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        bool filled = false;
+        if (mapped == NULL) {
+            std::cout << "Failed to map index buffer, uploading it instead" << std::endl;
+        }
+        else {
+            Perlin::generateHeightMapIndices(static_cast<unsigned int*>(mapped), 400, 400, STRIP_BLOCK_WIDTH);
+            filled = glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER) == GL_TRUE;
+            if (!filled)
+                std::cout << "Index buffer contents lost while mapped, uploading it instead" << std::endl;
+        }
+        if (!filled) {
+            std::vector<unsigned int> gridIndices = perlin.generateHeightMapIndices(400, 400, STRIP_BLOCK_WIDTH);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, gridIndices.size() * sizeof(unsigned int), gridIndices.data());
+        }
+        // the mapping is write-only, so the strips are measured on a patch four blocks wide, whose ACMR is
+        // within a few percent of the full grid's (0.542 against 0.535 with 15-cell blocks)
+        const int patch = std::min(4 * STRIP_BLOCK_WIDTH + 1, 400);
+        std::vector<unsigned int> patchTriangles = MeshOptimizer::stripToTriangles(perlin.generateHeightMapIndices(patch, patch, STRIP_BLOCK_WIDTH));
+        VertexCacheStats cacheStats = MeshOptimizer::analyzeVertexCache(patchTriangles, static_cast<size_t>(patch) * patch, MeshOptimizer::CACHE_SIZE);
+        std::cout << "Index buffer ACMR " << cacheStats.acmr << ", ATVR " << cacheStats.atvr << " (" << patch << " x " << patch << " patch)\n";
+    }
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    // Points the VAO's vertex attribute at `buffer` (GL_ARRAY_BUFFER binding is left on it)
+    auto bindTerrainVertices = [&](unsigned int buffer) {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        if (quantized) {
+            // normalized uint16 -> [0, 1], decoded with heightScale/heightOffset in vertex.vs
+            glVertexAttribPointer(1, 1, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(uint16_t), (void*)0);
+            glEnableVertexAttribArray(1);
+        }
+        else {
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+        }
+    };
+    bindTerrainVertices(VBO);
+
+    // Runtime regeneration of the grid: a generator thread writes the new terrain straight into the
+    // next mapped buffer of the ring while the current one keeps rendering, then it is swapped in
+    std::unique_ptr<StreamBuffer> terrainStream;
+    if (STREAM_TERRAIN_UPDATES && !triangleList && !TILED_TERRAIN && !clipmapped)
+        terrainStream.reset(new StreamBuffer(GL_ARRAY_BUFFER, static_cast<size_t>(400) * 400 * (quantized ? sizeof(uint16_t) : 3 * sizeof(float))));
+    struct GeneratedTerrain {
+        HeightField field;
+        ScatterInstances instances; // empty unless scattering
+    };
+    std::future<GeneratedTerrain> pendingTerrain;
+    bool regenerateHeld = false;
+    auto regenerateTerrain = [&]() {
+        perlin = Perlin(); // reshuffles the shared permutation table; no generator is running now
+        void* dst = terrainStream->map();
+        return std::async(std::launch::async, [dst, quantized, scattered, scatterSettings]() {
+            std::vector<float> heights(static_cast<size_t>(400) * 400);
+            if (quantized)
+                Perlin::generateQuantizedHeightMap(static_cast<uint16_t*>(dst), heights.data(), 400, 400, 400);
+            else
+                Perlin::generateHeightMap(static_cast<float*>(dst), heights.data(), 400, 400, 400);
+            const float origin = (0 - 400 / 2.0f) / 5;
+            GeneratedTerrain generated = { HeightField(std::move(heights), 400, 400, origin, origin, 0.2f), ScatterInstances() };
+            if (scattered)
+                generated.instances = PoissonScatter::generate(generated.field, scatterSettings);
+            return generated;
+        });
+    };
     //glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     //glEnableVertexAttribArray(1);
 
+    // Tiled mode: tiles are cut from the same unbounded sample grid as the 400 x 400 map, whose sample
+    // (i, j) sits at world ((i - 200) / 5, (j - 200) / 5), and share one strip index buffer
+    const int tileSamples = TILE_CELLS + 1;
+    std::unique_ptr<TilePrefetcher> prefetcher;
+    std::unordered_map<TileKey, unsigned int, TileKeyHash> tileBuffers;
+    unsigned int tileVAO = 0, tileEBO = 0;
+    const size_t tileIndexCount = Perlin::heightMapIndexCount(tileSamples, tileSamples, STRIP_BLOCK_WIDTH);
+    if (TILED_TERRAIN) {
+        const float origin = (0 - 400 / 2.0f) / 5;
+        prefetcher.reset(new TilePrefetcher(TILE_CELLS / 5.0f, origin, origin, 0.0f, Perlin::HEIGHT_SCALE,
+            [tileSamples](int tileX, int tileZ) {
+                QuantizedHeightMap tile = Perlin::quantizedRange(tileSamples, tileSamples);
+                tile.heights.resize(static_cast<size_t>(tileSamples) * tileSamples);
+                Perlin::generateQuantizedTile(tile.heights.data(), nullptr, tileX * TILE_CELLS, tileZ * TILE_CELLS, tileSamples, tileSamples, 400);
+                return tile;
+            }));
+
+        glGenVertexArrays(1, &tileVAO);
+        glGenBuffers(1, &tileEBO);
+        glBindVertexArray(tileVAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tileEBO);
+        std::vector<unsigned int> tileIndices = perlin.generateHeightMapIndices(tileSamples, tileSamples, STRIP_BLOCK_WIDTH);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, tileIndices.size() * sizeof(unsigned int), tileIndices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(1);
+    }
+
+    // Clipmap mode samples the same unbounded grid as tiled mode, one level at a time
+    std::unique_ptr<HeightClipmap> clipmap;
+    std::unique_ptr<Shader> clipmapShader;
+    size_t clipmapUploads = 0, clipmapFrames = 0;
+    if (clipmapped) {
+        clipmap.reset(new HeightClipmap(CLIPMAP_LEVELS, CLIPMAP_SIZE, 0.0f, Perlin::HEIGHT_SCALE,
+            [](int x, int z) { return Perlin::heightAt(x, z, 400); }));
+        clipmapShader.reset(new Shader("clipmap.vs", "fragment.fs"));
+        if (HOT_RELOAD_SHADERS)
+            clipmapShader->watchFiles();
+        std::cout << "Clipmap textures: " << clipmap->textureBytes() << " bytes\n";
+    }
+
     // render loop
     while (!glfwWindowShouldClose(window))
     {
@@ -115,6 +349,53 @@ int main()
         lastFrame = currentFrame;
         // input
         processInput(window);
+        if (terrainStream) {
+            bool regenerate = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+            if (regenerate && !regenerateHeld && !pendingTerrain.valid())
+                pendingTerrain = regenerateTerrain();
+            regenerateHeld = regenerate;
+            if (pendingTerrain.valid() && pendingTerrain.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                GeneratedTerrain generated = pendingTerrain.get();
+                if (terrainStream->unmap()) {
+                    *terrain = std::move(generated.field);
+                    if (scattered)
+                        scatterRenderer.reset(new ScatterRenderer(generated.instances));
+                    bindTerrainVertices(terrainStream->current());
+                    if (quantized)
+                        quantizedData = Perlin::quantizedRange(400, 400); // streamed tiles use the fixed range
+                }
+            }
+        }
+        if (!volumetric) { // caves and overhangs have no single ground height
+            float ground = TILED_TERRAIN || clipmapped ? Perlin::heightAt(camera.Position.x * 5 + 200, camera.Position.z * 5 + 200, 400)
+                : terrain->height(camera.Position.x, camera.Position.z);
+            camera.Position.y = std::max(camera.Position.y, ground + CAMERA_GROUND_CLEARANCE);
+        }
+        if (prefetcher) {
+            prefetcher->update(camera, (float)SCR_WIDTH / (float)SCR_HEIGHT, NEAR_PLANE, FAR_PLANE, currentFrame);
+            for (const TileKey& key : prefetcher->takeEvicted()) {
+                auto it = tileBuffers.find(key);
+                if (it != tileBuffers.end()) {
+                    glDeleteBuffers(1, &it->second);
+                    tileBuffers.erase(it);
+                }
+            }
+            for (const TileKey& key : prefetcher->takeCompleted()) {
+                std::shared_ptr<const QuantizedHeightMap> tile = prefetcher->find(key);
+                if (!tile)
+                    continue;
+                unsigned int& buffer = tileBuffers[key];
+                if (buffer == 0)
+                    glGenBuffers(1, &buffer);
+                glBindBuffer(GL_ARRAY_BUFFER, buffer);
+                glBufferData(GL_ARRAY_BUFFER, tile->heights.size() * sizeof(uint16_t), tile->heights.data(), GL_STATIC_DRAW);
+            }
+        }
+        shader.reloadIfChanged();
+        if (clipmapShader)
+            clipmapShader->reloadIfChanged();
+        if (instanceShader)
+            instanceShader->reloadIfChanged();
 
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);        shader.use();
@@ -128,28 +409,89 @@ int main()
         // Bind the VAO of your quad
 
         glm::mat4 model = glm::mat4(1.0f);
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
         glm::mat4 view = camera.GetViewMatrix();
         shader.glUniformMat4("projection", projection);
         shader.glUniformMat4("view", view);
         shader.glUniformMat4("model", model);
-        glBindVertexArray(VAO);
-        // render the mesh triangle strip by triangle strip - each row at a time
-        for (unsigned int strip = 0; strip < NUM_STRIPS; ++strip)
-        {
-            glDrawElements(GL_TRIANGLE_STRIP,   // primitive type
-                NUM_VERTS_PER_STRIP, // number of indices to render
-                GL_UNSIGNED_INT,     // index data type
-                (void*)(sizeof(unsigned int)
-                    * NUM_VERTS_PER_STRIP
-                    * strip)); // offset to starting index
+        if (clipmap) {
+            clipmapUploads += clipmap->update(camera.Position.x * 5 + 200, camera.Position.z * 5 + 200);
+            clipmapFrames++;
+            clipmapShader->use();
+            clipmapShader->glUniformMat4("projection", projection);
+            clipmapShader->glUniformMat4("view", view);
+            // sample (i, j) of the grid sits at world ((i - 200) / 5, (j - 200) / 5)
+            clipmap->draw(*clipmapShader, -40.0f, -40.0f, 0.2f);
+        }
+        else if (prefetcher) {
+            // tiles still being generated are skipped; prefetching exists so that there are none
+            QuantizedHeightMap range = Perlin::quantizedRange(tileSamples, tileSamples);
+            shader.setBool("quantized", true);
+            shader.setInt("gridWidth", range.width);
+            shader.setInt("gridLength", range.length);
+            shader.setFloat("heightScale", range.scale * 65535.0f);
+            shader.setFloat("heightOffset", range.offset);
+            glBindVertexArray(tileVAO);
+            for (const TileKey& key : prefetcher->visible()) {
+                auto it = tileBuffers.find(key);
+                if (it == tileBuffers.end())
+                    continue;
+                // the shader centres each tile's samples on the origin; move it to its place in the grid
+                glm::vec3 center((key.x * TILE_CELLS + tileSamples / 2.0f - 200) / 5, 0.0f, (key.z * TILE_CELLS + tileSamples / 2.0f - 200) / 5);
+                shader.glUniformMat4("model", glm::translate(glm::mat4(1.0f), center));
+                glBindBuffer(GL_ARRAY_BUFFER, it->second);
+                glVertexAttribPointer(1, 1, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(uint16_t), (void*)0);
+                glDrawElements(GL_TRIANGLE_STRIP, static_cast<GLsizei>(tileIndexCount), GL_UNSIGNED_INT, (void*)0);
+            }
+        }
+        else {
+            shader.setBool("quantized", quantized);
+            if (quantized) {
+                shader.setInt("gridWidth", quantizedData.width);
+                shader.setInt("gridLength", quantizedData.length);
+                shader.setFloat("heightScale", quantizedData.scale * 65535.0f);
+                shader.setFloat("heightOffset", quantizedData.offset);
+            }
+            glBindVertexArray(VAO);
+            // a single call: rows and strip blocks are joined by degenerate triangles
+            glDrawElements(triangleList ? GL_TRIANGLES : GL_TRIANGLE_STRIP, static_cast<GLsizei>(indexCount), GL_UNSIGNED_INT, (void*)0);
         }
+        if (scatterRenderer) {
+            instanceShader->use();
+            instanceShader->glUniformMat4("projection", projection);
+            instanceShader->glUniformMat4("view", view);
+            scatterRenderer->draw(Frustum::fromMatrix(projection * view), camera.Position, SCATTER_FULL_DENSITY_DISTANCE);
+        }
+        if (terrainStream)
+            terrainStream->fence(); // its current buffer is not rewritten until this frame's draw is done
         glfwSwapBuffers(window);
         
         glfwPollEvents();
     }
 
     // Cleanup resources
+    if (pendingTerrain.valid()) {
+        pendingTerrain.wait();
+        terrainStream->unmap();
+    }
+    terrainStream.reset();
+    scatterRenderer.reset();
+    instanceShader.reset();
+    if (clipmap) {
+        std::cout << "Clipmap: " << clipmapUploads << " texels uploaded over " << clipmapFrames << " frames\n";
+        clipmap.reset();
+        clipmapShader.reset();
+    }
+    if (prefetcher) {
+        TilePrefetcher::Stats stats = prefetcher->statistics();
+        std::cout << "Tile prefetch: " << stats.hits << " hits, " << stats.misses << " misses (" << stats.hitRate() * 100.0f
+            << "% hit rate), " << stats.generated << " generated, " << stats.cancelled << " cancelled\n";
+        prefetcher.reset();
+        for (const auto& entry : tileBuffers)
+            glDeleteBuffers(1, &entry.second);
+        glDeleteVertexArrays(1, &tileVAO);
+        glDeleteBuffers(1, &tileEBO);
+    }
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
@@ -0,0 +1,36 @@
+#version 330 core
+// One level of HeightClipmap: a gridSize x gridSize grid with no vertex data, placed from
+// gl_VertexID at the level's window; heights come from the level's toroidally addressed texture
+
+uniform mat4 projection;
+uniform mat4 view;
+
+uniform sampler2D heights;  // normalized uint16, decoded with heightScale and heightOffset
+uniform int textureSize;    // a power of two
+uniform int gridSize;
+uniform int originX;        // first sample of the window, in the level's samples (always even)
+uniform int originZ;
+uniform float spacing;      // world distance between the level's samples
+uniform float worldOriginX; // world position of sample (0, 0)
+uniform float worldOriginZ;
+uniform float heightScale;
+uniform float heightOffset;
+
+float heightAt(int x, int z) {
+	return texelFetch(heights, ivec2(x & (textureSize - 1), z & (textureSize - 1)), 0).r * heightScale + heightOffset;
+}
+
+void main() {
+	int i = gl_VertexID % gridSize;
+	int j = gl_VertexID / gridSize;
+	int x = originX + i;
+	int z = originZ + j;
+	float h = heightAt(x, z);
+	// Odd vertices on the outer edge fall halfway along an edge of the coarser level around this one;
+	// give them that edge's height so the levels meet without cracks
+	if ((i == 0 || i == gridSize - 1) && (j & 1) == 1)
+		h = 0.5 * (heightAt(x, z - 1) + heightAt(x, z + 1));
+	else if ((j == 0 || j == gridSize - 1) && (i & 1) == 1)
+		h = 0.5 * (heightAt(x - 1, z) + heightAt(x + 1, z));
+	gl_Position = projection * view * vec4(worldOriginX + x * spacing, h, worldOriginZ + z * spacing, 1.0);
+}
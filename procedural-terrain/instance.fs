@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 FragColor;
+
+in float shade;
+
+void main() {
+    FragColor = vec4(0.15, 0.4, 0.1, 1.0) * shade;
+}
@@ -0,0 +1,21 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;     // object mesh
+layout(location = 1) in float aX;      // per instance (ScatterInstances, one buffer each)
+layout(location = 2) in float aY;
+layout(location = 3) in float aZ;
+layout(location = 4) in float aScale;
+layout(location = 5) in float aYaw;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+out float shade;
+
+void main() {
+	float c = cos(aYaw);
+	float s = sin(aYaw);
+	vec3 p = aPos * aScale;
+	vec3 world = vec3(c * p.x + s * p.z, p.y, c * p.z - s * p.x) + vec3(aX, aY, aZ);
+	shade = 0.5 + 0.5 * aPos.y; // darker at the base
+	gl_Position = projection * view * vec4(world, 1.0);
+}
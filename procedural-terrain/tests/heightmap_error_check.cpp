@@ -0,0 +1,55 @@
+// Standalone check that 16-bit quantized heightmaps stay within QuantizedHeightMap::maxError() of the
+// float heightmap they come from. No GL needed:
+//     g++ -std=c++14 -O2 -pthread -I.. heightmap_error_check.cpp -o heightmap_error_check
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "../utils/perlin.h"
+
+int Perlin::p[Perlin::GRADIENT_COUNT * 2];
+
+// Every sample of decoded must be within tile.maxError() of the generateHeightMap output (x and z exactly)
+static bool check(const char* name, const QuantizedHeightMap& tile, const std::vector<float>& expected) {
+    std::vector<float> decoded = tile.decode();
+    if (decoded.size() != expected.size()) {
+        std::cout << name << ": decoded " << decoded.size() << " floats, expected " << expected.size() << "\n";
+        return false;
+    }
+    const float bound = tile.maxError();
+    float worst = 0.0f;
+    size_t failures = 0;
+    for (size_t k = 0; k < expected.size(); k += 3) {
+        float error = std::fabs(decoded[k + 1] - expected[k + 1]);
+        worst = std::max(worst, error);
+        if (error > bound || decoded[k] != expected[k] || decoded[k + 2] != expected[k + 2]) {
+            if (failures++ < 5) {
+                std::cout << name << ": sample " << k / 3 << " decoded (" << decoded[k] << ", " << decoded[k + 1] << ", " << decoded[k + 2]
+                    << ") expected (" << expected[k] << ", " << expected[k + 1] << ", " << expected[k + 2] << ")\n";
+            }
+        }
+    }
+    std::cout << name << ": max error " << worst << " (bound " << bound << "), " << failures << " samples out of bound\n";
+    return failures == 0;
+}
+
+int main() {
+    Perlin perlin; // one permutation for every map below
+    bool ok = true;
+    const int sizes[][2] = { { 400, 400 }, { 257, 130 }, { 1, 1 } };
+    for (const auto& size : sizes) {
+        const int width = size[0], length = size[1];
+        std::vector<float> expected = perlin.generateHeightMap(width, length, 400);
+
+        // per-tile range
+        ok &= check("encode", perlin.generateQuantizedHeightMap(width, length, 400), expected);
+
+        // fixed [0, HEIGHT_SCALE] range, as the streamed and tiled paths write it
+        QuantizedHeightMap fixed = Perlin::quantizedRange(width, length);
+        fixed.heights.resize(static_cast<size_t>(width) * length);
+        Perlin::generateQuantizedHeightMap(fixed.heights.data(), nullptr, width, length, 400);
+        ok &= check("fixed range", fixed, expected);
+    }
+    std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok ? 0 : 1;
+}
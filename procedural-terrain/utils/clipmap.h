@@ -0,0 +1,236 @@
+#ifndef CLIPMAP_H
+#define CLIPMAP_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+#include <glad/glad.h>
+#include "heightmap.h"
+#include "shader.h"
+
+
+/*
+* Geometry clipmap over an unbounded height source: `levels` nested square grids centred on the
+* camera, level l spacing its samples 2^l apart, each backed by its own size x size 16-bit texture.
+
+Textures are addressed toroidally: sample (x, z) of level l always lives in texel (x mod size,
+z mod size). When the camera moves, a level's window slides and only the rows and columns that came
+into it (an L-shaped strip) are generated and written over the ones that left, with glTexSubImage2D.
+VRAM is levels * size^2 * 2 bytes and each frame uploads about the distance moved times the size,
+however large the world.
+
+Every level draws the same grid of size - 1 vertices per side, placed by clipmap.vs from gl_VertexID,
+minus a hole where the next finer level is. Windows start on even samples, which puts that hole at one
+of four offsets; all four, and the full grid for level 0, sit in one index buffer.
+*/
+class HeightClipmap {
+public:
+    // Height at sample (x, z) of the finest level, e.g. Perlin::heightAt or a lookup into stored tiles
+    typedef std::function<float(int x, int z)> Source;
+
+    // size is a power of two up to 256 (16-bit indices); heights are stored quantized over [minHeight, maxHeight]
+    HeightClipmap(int levels, int size, float minHeight, float maxHeight, Source source)
+        : levelCount(levels), textureSize(size), source(source) {
+        if (levels < 1 || size < 8 || size > 256 || (size & (size - 1)) != 0) {
+            throw std::runtime_error("Clipmap needs at least one level and a power-of-two size from 8 to 256");
+        }
+        range = QuantizedHeightMap::fixedRange(size, size, minHeight, maxHeight);
+        windows.resize(levels);
+        textures.resize(levels);
+        glGenTextures(levels, textures.data());
+        for (int l = 0; l < levels; l++) {
+            glBindTexture(GL_TEXTURE_2D, textures[l]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, size, size, 0, GL_RED, GL_UNSIGNED_SHORT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        buildMesh();
+    }
+
+    ~HeightClipmap() {
+        glDeleteTextures(levelCount, textures.data());
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &EBO);
+    }
+
+    HeightClipmap(const HeightClipmap&) = delete;
+    HeightClipmap& operator=(const HeightClipmap&) = delete;
+
+    /*
+    * Centres every level on (x, z), in finest-level samples, uploading what came into range.
+    * Returns the number of texels written (each level's whole window the first time).
+    */
+    size_t update(float x, float z) {
+        size_t uploaded = 0;
+        for (int l = 0; l < levelCount; l++) {
+            const float step = static_cast<float>(1 << l);
+            // windows start on even samples, so a level's window always nests in whole cells of the next
+            const int originX = (static_cast<int>(std::floor(x / step)) - textureSize / 2) & ~1;
+            const int originZ = (static_cast<int>(std::floor(z / step)) - textureSize / 2) & ~1;
+            Window& window = windows[l];
+            if (!window.valid || std::abs(originX - window.x) >= textureSize || std::abs(originZ - window.z) >= textureSize) {
+                uploaded += upload(l, originX, originX + textureSize, originZ, originZ + textureSize);
+            }
+            else {
+                // columns that came into range, for the full height of the new window...
+                if (originX != window.x) {
+                    const int x0 = originX > window.x ? window.x + textureSize : originX;
+                    const int x1 = originX > window.x ? originX + textureSize : window.x;
+                    uploaded += upload(l, x0, x1, originZ, originZ + textureSize);
+                }
+                // ...and rows that came into range, over the columns that were already there
+                if (originZ != window.z) {
+                    const int z0 = originZ > window.z ? window.z + textureSize : originZ;
+                    const int z1 = originZ > window.z ? originZ + textureSize : window.z;
+                    const int x0 = std::max(originX, window.x), x1 = std::min(originX, window.x) + textureSize;
+                    uploaded += upload(l, x0, x1, z0, z1);
+                }
+            }
+            window.x = originX;
+            window.z = originZ;
+            window.valid = true;
+        }
+        return uploaded;
+    }
+
+    /*
+    * Draws every level with clipmap.vs (bound, with projection and view set). Sample (x, z) of the finest
+    * level is placed at world (worldX + x * spacing, worldZ + z * spacing).
+    */
+    void draw(Shader& shader, float worldX, float worldZ, float spacing) {
+        shader.setInt("heights", 0);
+        shader.setInt("textureSize", textureSize);
+        shader.setInt("gridSize", textureSize - 1);
+        shader.setFloat("worldOriginX", worldX);
+        shader.setFloat("worldOriginZ", worldZ);
+        shader.setFloat("heightScale", range.scale * 65535.0f);
+        shader.setFloat("heightOffset", range.offset);
+        glActiveTexture(GL_TEXTURE0);
+        glBindVertexArray(VAO);
+        for (int l = 0; l < levelCount; l++) {
+            if (!windows[l].valid) {
+                continue;
+            }
+            int variant = 0;
+            if (l > 0) {
+                // where the finer window sits in this one, in this level's samples: size / 4 or one more
+                int holeX = windows[l - 1].x / 2 - windows[l].x - textureSize / 4;
+                int holeZ = windows[l - 1].z / 2 - windows[l].z - textureSize / 4;
+                if (holeX < 0 || holeX > 1 || holeZ < 0 || holeZ > 1) {
+                    continue; // not nested yet; update() always leaves them nested
+                }
+                variant = 1 + holeZ * 2 + holeX;
+            }
+            glBindTexture(GL_TEXTURE_2D, textures[l]);
+            shader.setInt("originX", windows[l].x);
+            shader.setInt("originZ", windows[l].z);
+            shader.setFloat("spacing", spacing * (1 << l));
+            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(variants[variant].count), GL_UNSIGNED_SHORT,
+                (void*)(variants[variant].first * sizeof(uint16_t)));
+        }
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    int levels() const { return levelCount; }
+    int size() const { return textureSize; }
+    // Bytes of texture memory, fixed at construction
+    size_t textureBytes() const { return static_cast<size_t>(levelCount) * textureSize * textureSize * sizeof(uint16_t); }
+
+private:
+    struct Window {
+        int x = 0, z = 0; // first sample, in the level's own samples
+        bool valid = false;
+    };
+
+    struct Variant {
+        size_t first = 0;
+        size_t count = 0;
+    };
+
+    int levelCount;
+    int textureSize;
+    Source source;
+    QuantizedHeightMap range;
+    std::vector<Window> windows;
+    std::vector<unsigned int> textures;
+    std::vector<uint16_t> staging;
+    unsigned int VAO = 0, EBO = 0;
+    Variant variants[5]; // the full grid, then the hole at offsets (0, 0), (1, 0), (0, 1), (1, 1) past size / 4
+
+    // Generates and uploads samples [x0, x1) x [z0, z1) of level l, cut where the texture wraps
+    size_t upload(int l, int x0, int x1, int z0, int z1) {
+        if (x0 >= x1 || z0 >= z1) {
+            return 0;
+        }
+        const int mask = textureSize - 1;
+        glBindTexture(GL_TEXTURE_2D, textures[l]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        size_t texels = 0;
+        for (int zs = z0; zs < z1; ) {
+            const int ze = std::min(z1, zs + textureSize - (zs & mask));
+            for (int xs = x0; xs < x1; ) {
+                const int xe = std::min(x1, xs + textureSize - (xs & mask));
+                fill(l, xs, xe, zs, ze);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, xs & mask, zs & mask, xe - xs, ze - zs, GL_RED, GL_UNSIGNED_SHORT, staging.data());
+                texels += static_cast<size_t>(xe - xs) * (ze - zs);
+                xs = xe;
+            }
+            zs = ze;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texels;
+    }
+
+    void fill(int l, int x0, int x1, int z0, int z1) {
+        const float inv = range.scale > 0.0f ? 1.0f / range.scale : 0.0f;
+        staging.resize(static_cast<size_t>(x1 - x0) * (z1 - z0));
+        uint16_t* dst = staging.data();
+        for (int z = z0; z < z1; z++) {
+            for (int x = x0; x < x1; x++) {
+                *dst++ = QuantizedHeightMap::quantize(source(x * (1 << l), z * (1 << l)), range.offset, inv);
+            }
+        }
+    }
+
+    void buildMesh() {
+        const int grid = textureSize - 1;             // vertices per side
+        const int cells = grid - 1;
+        const int hole = textureSize / 2 - 1;         // cells of the finer level, in this level's cells
+        std::vector<uint16_t> indices;
+        for (int v = 0; v < 5; v++) {
+            const int holeX = v == 0 ? cells : textureSize / 4 + ((v - 1) & 1);
+            const int holeZ = v == 0 ? cells : textureSize / 4 + ((v - 1) >> 1);
+            variants[v].first = indices.size();
+            for (int j = 0; j < cells; j++) {
+                for (int i = 0; i < cells; i++) {
+                    if (i >= holeX && i < holeX + hole && j >= holeZ && j < holeZ + hole) {
+                        continue;
+                    }
+                    const uint16_t a = static_cast<uint16_t>(j * grid + i), b = static_cast<uint16_t>(a + 1);
+                    const uint16_t c = static_cast<uint16_t>(a + grid), d = static_cast<uint16_t>(c + 1);
+                    const uint16_t cell[6] = { a, c, b, b, c, d };
+                    indices.insert(indices.end(), cell, cell + 6);
+                }
+            }
+            variants[v].count = indices.size() - variants[v].first;
+        }
+
+        // no vertex attributes: clipmap.vs builds each vertex from gl_VertexID
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &EBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+    }
+};
+
+#endif
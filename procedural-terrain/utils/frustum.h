@@ -0,0 +1,49 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <cmath>
+#include <glm/glm.hpp>
+
+
+/*
+* View frustum as six inward-facing planes, extracted from a projection * view matrix
+* (Gribb & Hartmann). A point p is inside when dot(plane, vec4(p, 1)) >= 0 for every plane.
+*/
+struct Frustum {
+    glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+    static Frustum fromMatrix(const glm::mat4& viewProjection) {
+        // glm is column-major: row r of the matrix is (m[0][r], m[1][r], m[2][r], m[3][r])
+        const glm::mat4& m = viewProjection;
+        glm::vec4 row[4];
+        for (int r = 0; r < 4; r++) {
+            row[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+        }
+        Frustum frustum;
+        for (int axis = 0; axis < 3; axis++) {
+            frustum.planes[axis * 2] = row[3] + row[axis];
+            frustum.planes[axis * 2 + 1] = row[3] - row[axis];
+        }
+        for (glm::vec4& plane : frustum.planes) {
+            float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+            plane = plane * (1.0f / length);
+        }
+        return frustum;
+    }
+
+    // Conservative box test: false only when the box is wholly outside one plane
+    bool intersects(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+        for (const glm::vec4& plane : planes) {
+            // the box corner furthest along the plane normal
+            glm::vec3 corner(plane.x >= 0.0f ? boxMax.x : boxMin.x,
+                plane.y >= 0.0f ? boxMax.y : boxMin.y,
+                plane.z >= 0.0f ? boxMax.z : boxMin.z);
+            if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif
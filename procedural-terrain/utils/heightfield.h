@@ -0,0 +1,357 @@
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#include <glm/glm.hpp>
+#include "heightmap.h"
+
+
+/*
+* Read-only height queries over a generated heightmap: bilinear height and normal at a world (x, z),
+* batched lookups, and ray intersection.
+
+Samples keep the layout of Perlin::generateHeightMap: row i lies along world x and column j along
+world z, spaced `spacing` apart from (originX, originZ). Between samples the surface is the bilinear
+patch of the four surrounding heights, for both height() and raycast(), so the two always agree.
+
+Raycasts descend a min/max pyramid built with the field: level 0 holds the height range of each
+2x2 block of cells, and every level above merges 2x2 nodes of the one below. Nodes are visited front to back, so
+the first patch hit is the nearest one and whole subtrees the ray passes over are skipped.
+
+All queries are const and keep no scratch state, so any number of threads may share one field.
+*/
+class HeightField {
+public:
+    HeightField(std::vector<float> heights, int width, int length, float originX, float originZ, float spacing)
+        : samples(std::move(heights)), width(width), length(length), originX(originX), originZ(originZ), spacing(spacing) {
+        buildPyramid();
+    }
+
+    // From the interleaved XYZ output of Perlin::generateHeightMap
+    static HeightField fromHeightMap(const std::vector<float>& textureData, int width, int length) {
+        std::vector<float> heights(static_cast<size_t>(width) * length);
+        for (size_t k = 0; k < heights.size(); k++) {
+            heights[k] = textureData[k * 3 + 1];
+        }
+        float spacing = length > 1 ? textureData[static_cast<size_t>(width) * 3] - textureData[0] : 1.0f;
+        return HeightField(std::move(heights), width, length, textureData[0], textureData[2], spacing);
+    }
+
+    static HeightField fromQuantized(const QuantizedHeightMap& tile) {
+        return fromHeightMap(tile.decode(), tile.width, tile.length);
+    }
+
+    // Bilinear height at world (x, z); positions off the map take the nearest edge
+    float height(float x, float z) const {
+        float gi = clampCoord((x - originX) / spacing, length);
+        float gj = clampCoord((z - originZ) / spacing, width);
+        int i = std::min(static_cast<int>(gi), std::max(length - 2, 0));
+        int j = std::min(static_cast<int>(gj), std::max(width - 2, 0));
+        float u = gi - i, v = gj - j;
+
+        const float* row0 = &samples[static_cast<size_t>(i) * width + j];
+        const float* row1 = length > 1 ? row0 + width : row0;
+        int dj = width > 1 ? 1 : 0;
+        float h0 = row0[0] + (row0[dj] - row0[0]) * v;
+        float h1 = row1[0] + (row1[dj] - row1[0]) * v;
+        return h0 + (h1 - h0) * u;
+    }
+
+    // Surface normal at world (x, z) from central differences of the bilinear height
+    glm::vec3 normal(float x, float z) const {
+        float dx = height(x + spacing, z) - height(x - spacing, z);
+        float dz = height(x, z + spacing) - height(x, z - spacing);
+        return glm::normalize(glm::vec3(-dx, 2.0f * spacing, -dz));
+    }
+
+    // Batched height(), one lookup per point; it shares no state between calls, so callers may split a batch across threads
+    void heights(const float* xs, const float* zs, float* out, size_t count) const {
+        for (size_t k = 0; k < count; k++) {
+            out[k] = height(xs[k], zs[k]);
+        }
+    }
+
+    /*
+    * Nearest intersection of origin + t * direction with the surface for t in [0, maxDistance].
+    * direction need not be normalized; t is in its units. Returns false when nothing is hit.
+    * The terrain is solid below the surface: a ray that starts under it, or comes in through a side
+    * of the map under it, hits at the first t where it is over the map (0 if it starts there).
+    */
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& hitT) const {
+        if (length < 2 || width < 2) {
+            return false;
+        }
+        // Work in grid units across the map, world units vertically
+        Ray ray;
+        ray.oi = (origin.x - originX) / spacing;
+        ray.oj = (origin.z - originZ) / spacing;
+        ray.oy = origin.y;
+        ray.di = direction.x / spacing;
+        ray.dj = direction.z / spacing;
+        ray.dy = direction.y;
+        ray.invDi = ray.di != 0.0f ? 1.0f / ray.di : 0.0f;
+        ray.invDj = ray.dj != 0.0f ? 1.0f / ray.dj : 0.0f;
+
+        struct Entry { int level, ci, cj; float tEnter, tExit; };
+        Entry stack[3 * 32];
+        int top = 0;
+        int rootLevel = static_cast<int>(levels.size()) - 1;
+        float t0, t1;
+        if (!span(ray, static_cast<float>(2 << rootLevel), 0, 0, t0, t1) || t1 < 0.0f || t0 > maxDistance) {
+            return false;
+        }
+        stack[top++] = { rootLevel, 0, 0, std::max(t0, 0.0f), std::min(t1, maxDistance) };
+
+        while (top > 0) {
+            Entry node = stack[--top];
+
+            // The ray crosses the node's two midlines at most once each, which splits [tEnter, tExit]
+            // into up to three pieces, each inside one child; they come out in order, nearest first
+            float half = static_cast<float>(1 << node.level);
+            float midI = (node.ci * 2 + 1) * half, midJ = (node.cj * 2 + 1) * half;
+            float cuts[4] = { node.tEnter, crossing(ray.oi, ray.invDi, midI), crossing(ray.oj, ray.invDj, midJ), node.tExit };
+            if (cuts[1] > cuts[2]) {
+                std::swap(cuts[1], cuts[2]);
+            }
+
+            Entry children[3];
+            int count = 0;
+            bool cells = node.level == 0;
+            const Range* ranges = cells ? nullptr : &levels[node.level - 1].ranges[childBlock(levels[node.level - 1], node.ci, node.cj)];
+            float from = node.tEnter;
+            for (int c = 1; c < 4; c++) {
+                float to = std::min(std::max(cuts[c], from), node.tExit);
+                if (to <= from) {
+                    continue;
+                }
+                float t = (from + to) * 0.5f;
+                int k = (ray.oi + ray.di * t >= midI ? 2 : 0) + (ray.oj + ray.dj * t >= midJ ? 1 : 0);
+                int ci = node.ci * 2 + (k >> 1), cj = node.cj * 2 + (k & 1);
+                if (cells) {
+                    // bottom level: the children are cells, tested directly against their patches
+                    if (ci < length - 1 && cj < width - 1 && intersectPatch(ray, ci, cj, from, to, hitT)) {
+                        return true;
+                    }
+                }
+                else if (overlapsHeight(ray, from, to, ranges[k])) {
+                    children[count++] = { node.level - 1, ci, cj, from, to };
+                }
+                from = to;
+            }
+            // nearest on top of the stack
+            while (count > 0) {
+                stack[top++] = children[--count];
+            }
+        }
+        return false;
+    }
+
+    // Batched raycast(); misses are reported as a negative t. threads = 0 uses every hardware thread.
+    void raycasts(const glm::vec3* origins, const glm::vec3* directions, size_t count, float maxDistance, float* hitT, int threads = 1) const {
+        auto cast = [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                if (!raycast(origins[k], directions[k], maxDistance, hitT[k])) {
+                    hitT[k] = -1.0f;
+                }
+            }
+        };
+
+        if (threads <= 0) {
+            threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        }
+        threads = static_cast<int>(std::min<size_t>(threads, count));
+        if (threads <= 1) {
+            cast(0, count);
+            return;
+        }
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back(cast, count * t / threads, count * (t + 1) / threads);
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // World-space rectangle the samples cover
+    void extent(float& minX, float& minZ, float& maxX, float& maxZ) const {
+        minX = originX;
+        minZ = originZ;
+        maxX = originX + (length - 1) * spacing;
+        maxZ = originZ + (width - 1) * spacing;
+    }
+
+    float minHeight() const { return levels.back().ranges[0].min; }
+    float maxHeight() const { return levels.back().ranges[0].max; }
+
+private:
+    struct Range { float min, max; };
+    // Level 0 nodes cover 2x2 cells and each level above 2x2 nodes of the one below. Ranges are stored
+    // in 2x2 blocks so the four children of a node share a cache line.
+    struct Level {
+        int rows, cols; // in nodes
+        std::vector<Range> ranges;
+    };
+    struct Ray { float oi, oj, oy, di, dj, dy, invDi, invDj; };
+
+    std::vector<float> samples;
+    int width;
+    int length;
+    float originX;
+    float originZ;
+    float spacing;
+    std::vector<Level> levels;
+
+    static float clampCoord(float g, int count) {
+        return std::min(std::max(g, 0.0f), static_cast<float>(std::max(count - 1, 0)));
+    }
+
+    // First of the four ranges of the 2x2 block holding nodes (2 * bi .. 2 * bi + 1, 2 * bj .. 2 * bj + 1)
+    static size_t childBlock(const Level& level, int bi, int bj) {
+        return (static_cast<size_t>(bi) * ((level.cols + 1) / 2) + bj) * 4;
+    }
+
+    static Range& rangeAt(Level& level, int i, int j) {
+        return level.ranges[childBlock(level, i / 2, j / 2) + (i & 1) * 2 + (j & 1)];
+    }
+
+    static Level makeLevel(int rows, int cols) {
+        Level level;
+        level.rows = rows;
+        level.cols = cols;
+        // padding nodes keep an empty range, so no ray ever enters them
+        level.ranges.assign(static_cast<size_t>((rows + 1) / 2) * ((cols + 1) / 2) * 4,
+            { std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() });
+        return level;
+    }
+
+    void buildPyramid() {
+        Level base = makeLevel(length / 2, width / 2);
+        for (int i = 0; i < length; i++) {
+            for (int j = 0; j < width; j++) {
+                // a sample bounds every node whose cells it is a corner of
+                float h = samples[static_cast<size_t>(i) * width + j];
+                for (int ni = std::max(i - 1, 0) / 2; ni <= std::min(i, length - 2) / 2; ni++) {
+                    for (int nj = std::max(j - 1, 0) / 2; nj <= std::min(j, width - 2) / 2; nj++) {
+                        Range& r = rangeAt(base, ni, nj);
+                        r.min = std::min(r.min, h);
+                        r.max = std::max(r.max, h);
+                    }
+                }
+            }
+        }
+        levels.push_back(std::move(base));
+
+        while (levels.back().rows > 1 || levels.back().cols > 1) {
+            Level& below = levels.back();
+            Level up = makeLevel((below.rows + 1) / 2, (below.cols + 1) / 2);
+            for (int i = 0; i < up.rows; i++) {
+                for (int j = 0; j < up.cols; j++) {
+                    const Range* children = &below.ranges[childBlock(below, i, j)];
+                    Range& p = rangeAt(up, i, j);
+                    for (int k = 0; k < 4; k++) {
+                        p.min = std::min(p.min, children[k].min);
+                        p.max = std::max(p.max, children[k].max);
+                    }
+                }
+            }
+            levels.push_back(std::move(up));
+        }
+    }
+
+    // Parameter interval where the ray is over the square of `size` cells at (ci, cj); false if it never is
+    bool span(const Ray& ray, float size, int ci, int cj, float& t0, float& t1) const {
+        float i0 = ci * size, i1 = std::min((ci + 1) * size, static_cast<float>(length - 1));
+        float j0 = cj * size, j1 = std::min((cj + 1) * size, static_cast<float>(width - 1));
+        if (i0 >= i1 || j0 >= j1) {
+            return false;
+        }
+        t0 = -std::numeric_limits<float>::max();
+        t1 = std::numeric_limits<float>::max();
+        return slab(ray.oi, ray.invDi, i0, i1, t0, t1) && slab(ray.oj, ray.invDj, j0, j1, t0, t1);
+    }
+
+    // t at which the ray crosses the line at `at`; never for a ray parallel to it
+    static float crossing(float o, float inv, float at) {
+        return inv == 0.0f ? std::numeric_limits<float>::max() : (at - o) * inv;
+    }
+
+    // inv is 1 / direction, or 0 for a ray parallel to the slab
+    static bool slab(float o, float inv, float lo, float hi, float& t0, float& t1) {
+        if (inv == 0.0f) {
+            return o >= lo && o <= hi;
+        }
+        float a = (lo - o) * inv, b = (hi - o) * inv;
+        if (a > b) {
+            std::swap(a, b);
+        }
+        t0 = std::max(t0, a);
+        t1 = std::min(t1, b);
+        return t0 <= t1;
+    }
+
+    // Whether the ray over [t0, t1] can reach down to the node's surface; a ray below the node's
+    // [min, max] range is inside the terrain, which is a hit too
+    static bool overlapsHeight(const Ray& ray, float t0, float t1, const Range& range) {
+        if (t0 > t1) {
+            return false;
+        }
+        float y0 = ray.oy + ray.dy * t0, y1 = ray.oy + ray.dy * t1;
+        return std::min(y0, y1) <= range.max;
+    }
+
+    // First t in [t0, t1] where the ray meets the bilinear patch of cell (i, j)
+    bool intersectPatch(const Ray& ray, int i, int j, float t0, float t1, float& hitT) const {
+        if (t0 > t1) {
+            return false;
+        }
+        const float* row0 = &samples[static_cast<size_t>(i) * width + j];
+        const float* row1 = row0 + width;
+        float h00 = row0[0], h01 = row0[1], h10 = row1[0], h11 = row1[1];
+        float A = h10 - h00, B = h01 - h00, C = h00 - h10 - h01 + h11;
+        // expand around the entry point rather than the origin, which may be far across the map
+        float u0 = ray.oi + ray.di * t0 - i, v0 = ray.oj + ray.dj * t0 - j, y0 = ray.oy + ray.dy * t0;
+
+        // ray height minus patch height is a quadratic a s^2 + b s + c in s = t - t0
+        float a = -C * ray.di * ray.dj;
+        float b = ray.dy - (A * ray.di + B * ray.dj + C * (u0 * ray.dj + v0 * ray.di));
+        float c = y0 - (h00 + A * u0 + B * v0 + C * u0 * v0);
+        if (c <= 0.0f) {
+            hitT = t0; // already at or under the surface where the ray enters the cell
+            return true;
+        }
+
+        // Roots in increasing order
+        float roots[2];
+        int rootCount = 0;
+        if (std::fabs(a) < 1e-12f) {
+            if (b != 0.0f) {
+                roots[rootCount++] = -c / b;
+            }
+        }
+        else {
+            float disc = b * b - 4.0f * a * c;
+            if (disc >= 0.0f) {
+                float sq = std::sqrt(disc);
+                // numerically stable pair
+                float q = -0.5f * (b + (b >= 0.0f ? sq : -sq));
+                float r0 = q / a, r1 = q != 0.0f ? c / q : r0;
+                roots[rootCount++] = std::min(r0, r1);
+                roots[rootCount++] = std::max(r0, r1);
+            }
+        }
+        for (int r = 0; r < rootCount; r++) {
+            if (roots[r] >= 0.0f && roots[r] <= t1 - t0) {
+                hitT = t0 + roots[r];
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif
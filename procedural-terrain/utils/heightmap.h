@@ -0,0 +1,129 @@
+#ifndef HEIGHTMAP_H
+#define HEIGHTMAP_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+// A heightmap tile quantized to 16 bits: height = heights[k] * scale + offset.
+// scale and offset are chosen per tile from its own min/max, so the error is at most scale / 2.
+struct QuantizedHeightMap {
+    int width = 0;
+    int length = 0;
+    float scale = 0.0f;
+    float offset = 0.0f;
+    std::vector<uint16_t> heights;
+
+    static QuantizedHeightMap encode(const std::vector<float>& values, int width, int length) {
+        QuantizedHeightMap tile;
+        tile.width = width;
+        tile.length = length;
+        tile.heights.resize(values.size());
+        if (values.empty())
+            return tile;
+
+        auto range = std::minmax_element(values.begin(), values.end());
+        tile.offset = *range.first;
+        tile.scale = (*range.second - *range.first) / 65535.0f;
+
+        float inv = tile.scale > 0.0f ? 1.0f / tile.scale : 0.0f;
+        for (size_t k = 0; k < values.size(); k++) {
+            tile.heights[k] = quantize(values[k], tile.offset, inv);
+        }
+        return tile;
+    }
+
+    // Scale and offset for a fixed [minHeight, maxHeight] range, with no samples; for tiles whose
+    // heights are quantized as they are generated, before their own range is known
+    static QuantizedHeightMap fixedRange(int width, int length, float minHeight, float maxHeight) {
+        QuantizedHeightMap tile;
+        tile.width = width;
+        tile.length = length;
+        tile.offset = minHeight;
+        tile.scale = (maxHeight - minHeight) / 65535.0f;
+        return tile;
+    }
+
+    // inv is 1 / scale (0 for a flat tile)
+    static uint16_t quantize(float value, float offset, float inv) {
+        float q = std::round((value - offset) * inv);
+        return static_cast<uint16_t>(std::min(std::max(q, 0.0f), 65535.0f));
+    }
+
+    float height(int i, int j) const {
+        return heights[static_cast<size_t>(i) * width + j] * scale + offset;
+    }
+
+    // Worst-case absolute difference from the float heights this tile was encoded from
+    // (half a quantization step, plus float rounding in the encode/decode arithmetic)
+    float maxError() const {
+        float magnitude = std::fabs(offset) + scale * 65535.0f;
+        return scale * 0.5f + 4.0f * std::numeric_limits<float>::epsilon() * magnitude;
+    }
+
+    // Expands back to the interleaved XYZ layout produced by Perlin::generateHeightMap
+    std::vector<float> decode() const {
+        std::vector<float> textureData;
+        textureData.reserve(heights.size() * 3);
+        for (int i = 0; i < length; i++) {
+            for (int j = 0; j < width; j++) {
+                textureData.push_back((i - length / 2.0f) / 5);
+                textureData.push_back(height(i, j));
+                textureData.push_back((j - width / 2.0f) / 5);
+            }
+        }
+        return textureData;
+    }
+
+    /*
+    * On-disk form: "HMQ1", int32 width, int32 length, float scale, float offset,
+    * then width * length uint16 heights in row order (host byte order).
+    */
+    void save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) {
+            throw std::runtime_error("Failed to open heightmap file for writing: " + path);
+        }
+        int32_t dims[2] = { width, length };
+        float range[2] = { scale, offset };
+        out.write("HMQ1", 4);
+        out.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+        out.write(reinterpret_cast<const char*>(range), sizeof(range));
+        out.write(reinterpret_cast<const char*>(heights.data()), heights.size() * sizeof(uint16_t));
+    }
+
+    static QuantizedHeightMap load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            throw std::runtime_error("Failed to open heightmap file for reading: " + path);
+        }
+        char magic[4];
+        int32_t dims[2];
+        float range[2];
+        in.read(magic, 4);
+        in.read(reinterpret_cast<char*>(dims), sizeof(dims));
+        in.read(reinterpret_cast<char*>(range), sizeof(range));
+        if (!in || !std::equal(magic, magic + 4, "HMQ1") || dims[0] < 0 || dims[1] < 0) {
+            throw std::runtime_error("Not a quantized heightmap file: " + path);
+        }
+
+        QuantizedHeightMap tile;
+        tile.width = dims[0];
+        tile.length = dims[1];
+        tile.scale = range[0];
+        tile.offset = range[1];
+        tile.heights.resize(static_cast<size_t>(tile.width) * tile.length);
+        in.read(reinterpret_cast<char*>(tile.heights.data()), tile.heights.size() * sizeof(uint16_t));
+        if (!in) {
+            throw std::runtime_error("Truncated heightmap file: " + path);
+        }
+        return tile;
+    }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,224 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+
+// Post-transform cache behaviour of an index buffer, as measured by MeshOptimizer::analyzeVertexCache
+struct VertexCacheStats {
+    size_t transforms = 0; // vertex shader invocations (cache misses)
+    float acmr = 0.0f;     // average cache miss ratio: transforms per triangle (0.5 is ideal on a grid)
+    float atvr = 0.0f;     // average transform to vertex ratio: transforms per referenced vertex (1.0 is ideal)
+};
+
+
+/*
+* Index and vertex reordering for GPU vertex reuse.
+
+Indices from Perlin::generateHeightMapIndices are triangle strips; stripToTriangles turns them into
+a triangle list, optimizeVertexCache reorders that list with Tom Forsyth's linear-speed algorithm,
+and optimizeVertexFetch renumbers vertices in first-use order so fetches walk memory forwards.
+analyzeVertexCache simulates a FIFO post-transform cache to report the result.
+*/
+class MeshOptimizer {
+public:
+    static const int CACHE_SIZE = 32;
+
+    // Widest strip block (see Perlin::generateHeightMapIndices) whose rows stay in a FIFO cache of this
+    // size: the first row of a block loads 2 * (blockWidth + 1) vertices, and the next row must still hit them
+    static int stripBlockWidth(int cacheSize = CACHE_SIZE) {
+        return std::max(cacheSize / 2 - 1, 1);
+    }
+
+    // Triangle strip (with degenerate joins) to triangle list, dropping degenerate triangles
+    static std::vector<unsigned int> stripToTriangles(const std::vector<unsigned int>& strip) {
+        std::vector<unsigned int> triangles;
+        triangles.reserve(strip.size() * 3);
+        for (size_t k = 2; k < strip.size(); k++) {
+            unsigned int a = strip[k - 2], b = strip[k - 1], c = strip[k];
+            if (a == b || b == c || a == c) {
+                continue;
+            }
+            // every other triangle of a strip is wound the other way
+            if (k & 1) {
+                std::swap(a, b);
+            }
+            triangles.push_back(a);
+            triangles.push_back(b);
+            triangles.push_back(c);
+        }
+        return triangles;
+    }
+
+    // FIFO cache simulation over a triangle list
+    static VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize = CACHE_SIZE) {
+        VertexCacheStats stats;
+        std::vector<size_t> cachedAt(vertexCount, 0); // transform number (from 1) that loaded the vertex
+        std::vector<bool> referenced(vertexCount, false);
+        size_t uniqueVertices = 0;
+
+        for (unsigned int v : indices) {
+            // a FIFO holds the last cacheSize transformed vertices
+            if (cachedAt[v] == 0 || stats.transforms - cachedAt[v] >= static_cast<size_t>(cacheSize)) {
+                cachedAt[v] = ++stats.transforms;
+            }
+            if (!referenced[v]) {
+                referenced[v] = true;
+                uniqueVertices++;
+            }
+        }
+        if (!indices.empty()) {
+            stats.acmr = static_cast<float>(stats.transforms) / (indices.size() / 3);
+            stats.atvr = static_cast<float>(stats.transforms) / uniqueVertices;
+        }
+        return stats;
+    }
+
+    // Reorders triangles (in place) so that vertices are reused while still in the post-transform cache
+    static void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) {
+            return;
+        }
+
+        // Vertex -> triangle adjacency
+        std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+        for (unsigned int v : indices) {
+            adjacencyOffset[v + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++) {
+            adjacencyOffset[v + 1] += adjacencyOffset[v];
+        }
+        std::vector<unsigned int> adjacency(indices.size());
+        std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t k = 0; k < indices.size(); k++) {
+            adjacency[fill[indices[k]]++] = static_cast<unsigned int>(k / 3);
+        }
+
+        std::vector<unsigned int> liveTriangles(vertexCount);
+        std::vector<float> vertexScore(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++) {
+            liveTriangles[v] = adjacencyOffset[v + 1] - adjacencyOffset[v];
+            vertexScore[v] = score(-1, liveTriangles[v]);
+        }
+
+        std::vector<float> triangleScore(triangleCount);
+        std::vector<bool> emitted(triangleCount, false);
+        for (size_t t = 0; t < triangleCount; t++) {
+            triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+        }
+
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        std::vector<unsigned int> cache, nextCache;
+        size_t scanStart = 0;
+        long best = -1;
+
+        while (result.size() < indices.size()) {
+            if (best < 0) {
+                // Nothing useful in the cache: take the next unemitted triangle in input order
+                while (emitted[scanStart]) {
+                    scanStart++;
+                }
+                best = static_cast<long>(scanStart);
+            }
+
+            const unsigned int* tri = &indices[best * 3];
+            emitted[best] = true;
+            result.insert(result.end(), tri, tri + 3);
+
+            // Emitted vertices go to the front of the cache, the rest shift back
+            nextCache.assign(tri, tri + 3);
+            for (unsigned int v : cache) {
+                if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                    nextCache.push_back(v);
+                }
+            }
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = tri[k];
+                liveTriangles[v]--;
+                // keep this vertex's live triangles at the front of its adjacency span
+                unsigned int* begin = &adjacency[adjacencyOffset[v]];
+                unsigned int* end = begin + liveTriangles[v] + 1;
+                std::iter_swap(std::find(begin, end, static_cast<unsigned int>(best)), end - 1);
+            }
+
+            // Rescore everything that was or is in the cache and pick the best live triangle it touches
+            best = -1;
+            float bestScore = 0.0f;
+            for (size_t k = 0; k < nextCache.size(); k++) {
+                unsigned int v = nextCache[k];
+                int position = k < static_cast<size_t>(CACHE_SIZE) ? static_cast<int>(k) : -1;
+                float delta = score(position, liveTriangles[v]) - vertexScore[v];
+                vertexScore[v] += delta;
+                for (unsigned int a = 0; a < liveTriangles[v]; a++) {
+                    unsigned int t = adjacency[adjacencyOffset[v] + a];
+                    triangleScore[t] += delta;
+                }
+            }
+            for (size_t k = 0; k < nextCache.size() && k < static_cast<size_t>(CACHE_SIZE); k++) {
+                unsigned int v = nextCache[k];
+                for (unsigned int a = 0; a < liveTriangles[v]; a++) {
+                    unsigned int t = adjacency[adjacencyOffset[v] + a];
+                    if (triangleScore[t] > bestScore) {
+                        bestScore = triangleScore[t];
+                        best = t;
+                    }
+                }
+            }
+            if (nextCache.size() > static_cast<size_t>(CACHE_SIZE)) {
+                nextCache.resize(CACHE_SIZE);
+            }
+            cache.swap(nextCache);
+        }
+        indices.swap(result);
+    }
+
+    /*
+    * Renumbers vertices in the order the index buffer first uses them and reorders the vertex data
+    * to match. vertices holds `components` floats per vertex (3 for generateHeightMap's XYZ).
+    * Returns the new vertex count; vertices no index refers to are dropped.
+    */
+    static size_t optimizeVertexFetch(std::vector<float>& vertices, std::vector<unsigned int>& indices, int components = 3) {
+        const size_t vertexCount = vertices.size() / components;
+        std::vector<unsigned int> remap(vertexCount, ~0u);
+        std::vector<float> reordered;
+        reordered.reserve(vertices.size());
+        unsigned int next = 0;
+
+        for (unsigned int& v : indices) {
+            if (remap[v] == ~0u) {
+                remap[v] = next++;
+                reordered.insert(reordered.end(), &vertices[static_cast<size_t>(v) * components],
+                    &vertices[static_cast<size_t>(v) * components] + components);
+            }
+            v = remap[v];
+        }
+        vertices.swap(reordered);
+        return next;
+    }
+
+private:
+    // Forsyth's scoring: recently used vertices score high (the last triangle's three equally), and
+    // vertices with few triangles left get a boost so they are finished off rather than stranded
+    static float score(int cachePosition, unsigned int liveTriangles) {
+        if (liveTriangles == 0) {
+            return -1.0f;
+        }
+        float value = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                value = 0.75f;
+            }
+            else {
+                float scaler = 1.0f / (CACHE_SIZE - 3);
+                value = std::pow(1.0f - (cachePosition - 3) * scaler, 1.5f);
+            }
+        }
+        return value + 2.0f / std::sqrt(static_cast<float>(liveTriangles));
+    }
+};
+
+#endif
@@ -7,10 +7,15 @@
 #include <algorithm> // for std::shuffle
 #include <random>    // for std::default_random_engine
 #include <chrono>    // for std::chrono::system_clock
+#include <thread>
+#include <limits>
+#include "heightmap.h"
 
 
 class Perlin {
 public:
+    static constexpr float HEIGHT_SCALE = 20.0f; // Heights span [0, HEIGHT_SCALE]
+
     Perlin() {
         initPermutation(); // Initialize the permutation array in the constructor
     }
@@ -52,63 +57,239 @@ public:
         return result;
     }
 
-    std::vector<float> generateHeightMap(int width, int length, float grid_size) {
-        std::vector<float> textureData;
+    /*
+    * Bounds [lo, hi] of noise() over the box [x0, x1] x [y0, y1] x [z0, z1], by interval arithmetic on
+    * each lattice cell the box touches. Tight while the box is small next to a cell; boxes spanning
+    * more than two cells along an axis get the range of noise() as a whole.
+    */
+    static void noiseBounds(double x0, double y0, double z0, double x1, double y1, double z1, double& lo, double& hi) {
+        const double cx0 = std::floor(x0), cy0 = std::floor(y0), cz0 = std::floor(z0);
+        if (std::floor(x1) - cx0 > 1 || std::floor(y1) - cy0 > 1 || std::floor(z1) - cz0 > 1) {
+            // every corner term is g . d with two unit components of g and |d| <= 1 per axis
+            lo = -2.0;
+            hi = 2.0;
+            return;
+        }
+        lo = std::numeric_limits<double>::max();
+        hi = -std::numeric_limits<double>::max();
+        for (double cx = cx0; cx <= x1; cx++) {
+            for (double cy = cy0; cy <= y1; cy++) {
+                for (double cz = cz0; cz <= z1; cz++) {
+                    // the part of the box inside this cell, relative to the cell
+                    const double box[6] = {
+                        std::max(x0, cx) - cx, std::max(y0, cy) - cy, std::max(z0, cz) - cz,
+                        std::min(x1, cx + 1) - cx, std::min(y1, cy + 1) - cy, std::min(z1, cz + 1) - cz };
+                    double cellLo, cellHi;
+                    cellBounds(static_cast<int>(cx) & 255, static_cast<int>(cy) & 255, static_cast<int>(cz) & 255, box, cellLo, cellHi);
+                    lo = std::min(lo, cellLo);
+                    hi = std::max(hi, cellHi);
+                }
+            }
+        }
+    }
+
+    // Fractal height in [0, HEIGHT_SCALE] at grid coordinate (i, j)
+    static float heightAt(double i, double j, float grid_size) {
+        double val = 0.0;
+        float freq = 1.0f;
+        float amp = 1.0f;
         float z = 0.5f; // Use a constant z value for a static heightmap
 
-        for (int i = 0; i < length; i++) {
-            for (int j = 0; j < width; j++) {
-                double val = 0.0;
-                float freq = 1.0f;
-                float amp = 1.0f;
-
-                // Octaves to create multiple layers of noise
-                for (int o = 0; o < 12; o++) {
-                    val += Perlin::noise(i * freq / grid_size, j * freq / grid_size, z) * amp;
-                    freq *= 2.0f;  // Increase frequency
-                    amp /= 1.7f;   // Decrease amplitude
-                }
+        // Octaves to create multiple layers of noise
+        for (int o = 0; o < 12; o++) {
+            val += Perlin::noise(i * freq / grid_size, j * freq / grid_size, z) * amp;
+            freq *= 2.0f;  // Increase frequency
+            amp /= 1.7f;   // Decrease amplitude
+        }
 
-                // Adjust contrast
-                val *= 1.2;
+        // Adjust contrast
+        val *= 1.2;
 
-                // Clamp value to [-1, 1]
-                if (val > 1.0f)
-                    val = 1.0f;
-                else if (val < -1.0f)
-                    val = -1.0f;
+        // Clamp value to [-1, 1]
+        if (val > 1.0f)
+            val = 1.0f;
+        else if (val < -1.0f)
+            val = -1.0f;
 
-                // Normalize to [0, 1] and store in textureData
-                textureData.push_back((i - length / 2.0f) / 5);
-                textureData.push_back(static_cast<float>(((val + 1.0) / 2.0) * 20));
-                textureData.push_back((j - width / 2.0f)/5);
-            }
-        }
+        // Normalize to [0, 1] and scale
+        return static_cast<float>(((val + 1.0) / 2.0) * HEIGHT_SCALE);
+    }
+
+    std::vector<float> generateHeightMap(int width, int length, float grid_size) {
+        std::vector<float> textureData(static_cast<size_t>(width) * length * 3);
+        generateHeightMap(textureData.data(), nullptr, width, length, grid_size);
         return textureData;
     }
 
-    std::vector<unsigned int> generateHeightMapIndices(int width, int length) {
-        std::vector<unsigned int> indices;
-
-        for (int i = 0; i < length - 1; ++i) {
-            for (int j = 0; j < width; ++j) {
-                // Add vertex from current row
-                indices.push_back(i * width + j);
-                // Add vertex from next row
-                indices.push_back((i + 1) * width + j);
+    /*
+    * Writes the generateHeightMap layout straight to out (width * length * 3 floats), e.g. a mapped
+    * GL buffer, with rows split across threads. heights, if not null, also receives the width * length
+    * plain heights for CPU-side queries. threads = 0 uses every hardware thread.
+    */
+    static void generateHeightMap(float* out, float* heights, int width, int length, float grid_size, int threads = 0) {
+        parallelFor(length, threads, [=](size_t begin, size_t end) {
+            for (int i = static_cast<int>(begin); i < static_cast<int>(end); i++) {
+                for (int j = 0; j < width; j++) {
+                    size_t k = static_cast<size_t>(i) * width + j;
+                    float h = heightAt(i, j, grid_size);
+                    out[k * 3] = (i - length / 2.0f) / 5;
+                    out[k * 3 + 1] = h;
+                    out[k * 3 + 2] = (j - width / 2.0f) / 5;
+                    if (heights) {
+                        heights[k] = h;
+                    }
+                }
+            }
+        });
+    }
+
+    // Same heights as generateHeightMap, stored as uint16 against the tile's own [min, max] range.
+    // XZ is not stored; it follows from the sample index (see vertex.vs).
+    QuantizedHeightMap generateQuantizedHeightMap(int width, int length, float grid_size) {
+        std::vector<float> heights(static_cast<size_t>(width) * length);
+        parallelFor(length, 0, [&](size_t begin, size_t end) {
+            for (int i = static_cast<int>(begin); i < static_cast<int>(end); i++) {
+                for (int j = 0; j < width; j++) {
+                    heights[static_cast<size_t>(i) * width + j] = heightAt(i, j, grid_size);
+                }
             }
+        });
+        return QuantizedHeightMap::encode(heights, width, length);
+    }
+
+    /*
+    * Quantized heights written straight to out (width * length uint16). A tile written this way cannot
+    * know its own range first, so it is quantized against the fixed [0, HEIGHT_SCALE] range;
+    * quantizedRange() gives the matching scale and offset. heights and threads as for generateHeightMap.
+    */
+    static void generateQuantizedHeightMap(uint16_t* out, float* heights, int width, int length, float grid_size, int threads = 0) {
+        parallelFor(length, threads, [=](size_t begin, size_t end) {
+            size_t first = begin * width;
+            generateQuantizedTile(out + first, heights ? heights + first : nullptr,
+                static_cast<int>(begin), 0, width, static_cast<int>(end - begin), grid_size);
+        });
+    }
 
-            // Add degenerate triangles (if not the last row)
-            if (i < length - 2) {
-                // Add two degenerate vertices (the last and first vertices of the next row)
-                indices.push_back((i + 1) * width + (width - 1));
-                indices.push_back((i + 1) * width);
+    // The width x length samples from grid coordinate (rowOrigin, columnOrigin) on, quantized as above.
+    // Tiles sharing an edge share its samples, so tiles cut from one unbounded grid meet without seams.
+    static void generateQuantizedTile(uint16_t* out, float* heights, int rowOrigin, int columnOrigin, int width, int length, float grid_size) {
+        const float inv = 65535.0f / HEIGHT_SCALE;
+        for (int i = 0; i < length; i++) {
+            for (int j = 0; j < width; j++) {
+                size_t k = static_cast<size_t>(i) * width + j;
+                float h = heightAt(rowOrigin + i, columnOrigin + j, grid_size);
+                out[k] = QuantizedHeightMap::quantize(h, 0.0f, inv);
+                if (heights) {
+                    heights[k] = h;
+                }
             }
         }
+    }
+
+    static QuantizedHeightMap quantizedRange(int width, int length) {
+        return QuantizedHeightMap::fixedRange(width, length, 0.0f, HEIGHT_SCALE);
+    }
+
+    std::vector<unsigned int> generateHeightMapIndices(int width, int length) {
+        return generateHeightMapIndices(width, length, width - 1);
+    }
+
+    /*
+    * Same strip layout, but cut into column blocks of blockWidth cells: each block is stripped top to
+    * bottom before the next begins. A narrow strip reuses the previous row's vertices while they are
+    * still in the post-transform cache, which a 400-wide row never does. Blocks are joined with the
+    * same degenerate pair as rows, so the result is still drawn as a single GL_TRIANGLE_STRIP.
+    * blockWidth >= width - 1 gives plain row-by-row strips.
+    */
+    std::vector<unsigned int> generateHeightMapIndices(int width, int length, int blockWidth) {
+        std::vector<unsigned int> indices(heightMapIndexCount(width, length, blockWidth));
+        generateHeightMapIndices(indices.data(), width, length, blockWidth);
         return indices;
     }
 
+    // Exact number of indices generateHeightMapIndices produces, so callers can size buffers up front
+    static size_t heightMapIndexCount(int width, int length, int blockWidth) {
+        if (length < 2 || width < 2) {
+            return 0;
+        }
+        blockWidth = std::max(blockWidth, 1);
+        size_t blocks = (width - 1 + blockWidth - 1) / blockWidth;
+        size_t rows = length - 1;
+        // every block column is shared with its neighbour, hence width - 1 + blocks columns in all;
+        // each row of each block ends in a degenerate pair except the very last one
+        return 2 * rows * (width - 1 + blocks) + 2 * (blocks * rows - 1);
+    }
+
+    /*
+    * Writes the strip indices straight into out, which must hold heightMapIndexCount entries
+    * (a caller's array or a mapped GL buffer). Each (block, row) strip has a closed-form offset, so
+    * threads fill disjoint ranges with no shared state. threads = 0 uses every hardware thread.
+    */
+    static void generateHeightMapIndices(unsigned int* out, int width, int length, int blockWidth, int threads = 0) {
+        if (heightMapIndexCount(width, length, blockWidth) == 0) {
+            return;
+        }
+        blockWidth = std::max(blockWidth, 1);
+        const int blocks = (width - 1 + blockWidth - 1) / blockWidth;
+        const int rows = length - 1;
+        const size_t strips = static_cast<size_t>(blocks) * rows;
+        // full-width block: its rows, their degenerate pairs, and the join that leads into it
+        const size_t blockStride = 2 * static_cast<size_t>(rows) * (blockWidth + 1) + 2 * static_cast<size_t>(rows);
+
+        auto fill = [=](size_t begin, size_t end) {
+            for (size_t s = begin; s < end; s++) {
+                int b = static_cast<int>(s / rows);
+                int i = static_cast<int>(s % rows);
+                int c0 = b * blockWidth;
+                int c1 = std::min(c0 + blockWidth, width - 1);
+                // blocks before this one are all full width, and block b > 0 starts with its 2-index join
+                unsigned int* dst = out + b * blockStride + static_cast<size_t>(i) * (2 * (c1 - c0 + 1) + 2);
+
+                // Join from the end of the previous block to the top of this one
+                if (b > 0 && i == 0) {
+                    dst[-2] = rows * width + c0;
+                    dst[-1] = c0;
+                }
+                for (int j = c0; j <= c1; ++j) {
+                    // Add vertex from current row
+                    *dst++ = i * width + j;
+                    // Add vertex from next row
+                    *dst++ = (i + 1) * width + j;
+                }
+
+                // Add degenerate triangles (if not the last row)
+                if (i < rows - 1) {
+                    // Add two degenerate vertices (the last and first vertices of the next row)
+                    *dst++ = (i + 1) * width + c1;
+                    *dst++ = (i + 1) * width + c0;
+                }
+            }
+        };
+
+        parallelFor(strips, threads, fill);
+    }
+
 private:
+    // Runs fn(begin, end) over [0, count) split into one contiguous range per thread
+    template <typename Fn>
+    static void parallelFor(size_t count, int threads, Fn fn) {
+        if (threads <= 0) {
+            threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        }
+        threads = static_cast<int>(std::min<size_t>(threads, count));
+        if (threads <= 1) {
+            fn(0, count);
+            return;
+        }
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back(fn, count * t / threads, count * (t + 1) / threads);
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
     static double fade(double t) {
         return t * t * t * (t * (t * 6 - 15) + 10);
     }
@@ -124,6 +305,51 @@ private:
         return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
     }
 
+    // Range of grad() over the box [lo[0], hi[0]] x [lo[1], hi[1]] x [lo[2], hi[2]]
+    static void gradBounds(int hash, const double* lo, const double* hi, double& outLo, double& outHi) {
+        int h = hash & 15; // same axes and signs as grad()
+        int u = h < 8 ? 0 : 1;
+        int v = h < 4 ? 1 : (h == 12 || h == 14 ? 0 : 2);
+        double uLo = (h & 1) == 0 ? lo[u] : -hi[u], uHi = (h & 1) == 0 ? hi[u] : -lo[u];
+        double vLo = (h & 2) == 0 ? lo[v] : -hi[v], vHi = (h & 2) == 0 ? hi[v] : -lo[v];
+        outLo = uLo + vLo;
+        outHi = uHi + vHi;
+    }
+
+    // lerp() over t in [t0, t1] (within [0, 1]) and a, b in their ranges: it rises with a and b and is linear in t
+    static void lerpBounds(double t0, double t1, double aLo, double aHi, double bLo, double bHi, double& lo, double& hi) {
+        lo = std::min(lerp(t0, aLo, bLo), lerp(t1, aLo, bLo));
+        hi = std::max(lerp(t0, aHi, bHi), lerp(t1, aHi, bHi));
+    }
+
+    // Bounds of noise() over box (x0, y0, z0, x1, y1, z1, relative to and within lattice cell X, Y, Z)
+    static void cellBounds(int X, int Y, int Z, const double* box, double& lo, double& hi) {
+        int A = p[X] + Y, AA = p[A] + Z, AB = p[A + 1] + Z,
+            B = p[X + 1] + Y, BA = p[B] + Z, BB = p[B + 1] + Z;
+        const int hashes[8] = { p[AA], p[BA], p[AB], p[BB], p[AA + 1], p[BA + 1], p[AB + 1], p[BB + 1] };
+        // corner c sits at (c & 1, (c >> 1) & 1, c >> 2); its term is grad() of the offset from it
+        double cornerLo[8], cornerHi[8];
+        for (int c = 0; c < 8; c++) {
+            const double offset[3] = { static_cast<double>(c & 1), static_cast<double>((c >> 1) & 1), static_cast<double>(c >> 2) };
+            const double dLo[3] = { box[0] - offset[0], box[1] - offset[1], box[2] - offset[2] };
+            const double dHi[3] = { box[3] - offset[0], box[4] - offset[1], box[5] - offset[2] };
+            gradBounds(hashes[c], dLo, dHi, cornerLo[c], cornerHi[c]);
+        }
+        // fade() rises on [0, 1]
+        const double u0 = fade(box[0]), u1 = fade(box[3]);
+        const double v0 = fade(box[1]), v1 = fade(box[4]);
+        const double w0 = fade(box[2]), w1 = fade(box[5]);
+        double xLo[4], xHi[4];
+        for (int e = 0; e < 4; e++) {
+            lerpBounds(u0, u1, cornerLo[2 * e], cornerHi[2 * e], cornerLo[2 * e + 1], cornerHi[2 * e + 1], xLo[e], xHi[e]);
+        }
+        double yLo[2], yHi[2];
+        for (int f = 0; f < 2; f++) {
+            lerpBounds(v0, v1, xLo[2 * f], xHi[2 * f], xLo[2 * f + 1], xHi[2 * f + 1], yLo[f], yHi[f]);
+        }
+        lerpBounds(w0, w1, yLo[0], yHi[0], yLo[1], yHi[1], lo, hi);
+    }
+
     static const int GRADIENT_COUNT = 512;
     static int p[GRADIENT_COUNT * 2];
     static int permutation[256];
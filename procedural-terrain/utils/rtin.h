@@ -0,0 +1,200 @@
+#ifndef RTIN_H
+#define RTIN_H
+
+#include <cmath>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <limits>
+#include <algorithm>
+
+
+// Indexed triangle list in the interleaved XYZ layout of Perlin::generateHeightMap
+struct TerrainMesh {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices; // GL_TRIANGLES
+
+    size_t vertexCount() const { return vertices.size() / 3; }
+    size_t triangleCount() const { return indices.size() / 3; }
+
+    // Wavefront OBJ (y up, 1-based indices) for external tools
+    void saveObj(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            throw std::runtime_error("Failed to open mesh file for writing: " + path);
+        }
+        for (size_t v = 0; v < vertices.size(); v += 3) {
+            out << "v " << vertices[v] << " " << vertices[v + 1] << " " << vertices[v + 2] << "\n";
+        }
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            out << "f " << indices[t] + 1 << " " << indices[t + 1] + 1 << " " << indices[t + 2] + 1 << "\n";
+        }
+    }
+};
+
+
+/*
+* Right-triangulated irregular network (RTIN) simplification of a heightmap grid.
+
+The grid is covered by a binary tree of right triangles, each split at the midpoint of its
+hypotenuse. The constructor computes, for every split point, the largest vertical error over all
+samples covered by the triangles it splits and everything below them; getMesh then descends only
+while that error exceeds the requested bound, so the bound is strict rather than midpoint-only. Because a split point's error covers both triangles sharing
+that hypotenuse, the result is always crack-free.
+
+Grids that are not 2^k + 1 on a side are padded to the next such size. Triangles that straddle
+the real grid edge are always split (half-cell leaves never straddle it) and triangles wholly
+outside are dropped, so the mesh covers exactly the original grid.
+*/
+class Rtin {
+public:
+    Rtin(const std::vector<float>& textureData, int width, int length)
+        : textureData(textureData), width(width), length(length) {
+        tileSize = 1;
+        while (tileSize < width - 1 || tileSize < length - 1) {
+            tileSize *= 2;
+        }
+        gridSize = tileSize + 1;
+        computeErrors();
+    }
+
+    // Triangulation with at most maxError vertical deviation from the full grid
+    TerrainMesh getMesh(float maxError) const {
+        TerrainMesh mesh;
+        std::vector<int> vertexIndex(static_cast<size_t>(width) * length, -1);
+        processTriangle(mesh, vertexIndex, maxError, 0, 0, tileSize, tileSize, tileSize, 0);
+        processTriangle(mesh, vertexIndex, maxError, tileSize, tileSize, 0, 0, 0, tileSize);
+        return mesh;
+    }
+
+private:
+    const std::vector<float>& textureData;
+    int width;
+    int length;
+    int tileSize;
+    int gridSize;
+    std::vector<float> errors;
+
+    // x runs along a row (j < width), y across rows (i < length); padding repeats the edge samples
+    float height(int x, int y) const {
+        x = std::min(x, width - 1);
+        y = std::min(y, length - 1);
+        return textureData[(static_cast<size_t>(y) * width + x) * 3 + 1];
+    }
+
+    bool outside(int minX, int minY) const {
+        return minX >= width - 1 || minY >= length - 1;
+    }
+
+    void computeErrors() {
+        errors.assign(static_cast<size_t>(gridSize) * gridSize, 0.0f);
+        const int numTriangles = tileSize * tileSize * 2 - 2;
+        const int numParentTriangles = numTriangles - tileSize * tileSize;
+
+        // Walk from the smallest triangles up so children are done before their parents
+        for (int i = numTriangles - 1; i >= 0; i--) {
+            int ax, ay, bx, by, cx, cy;
+            triangleCoords(i + 2, ax, ay, bx, by, cx, cy);
+            int mx = (ax + bx) >> 1;
+            int my = (ay + by) >> 1;
+            size_t middle = static_cast<size_t>(my) * gridSize + mx;
+
+            float error = triangleError(ax, ay, bx, by, cx, cy);
+            int minX = std::min(ax, std::min(bx, cx)), maxX = std::max(ax, std::max(bx, cx));
+            int minY = std::min(ay, std::min(by, cy)), maxY = std::max(ay, std::max(by, cy));
+            if (!outside(minX, minY) && (maxX > width - 1 || maxY > length - 1)) {
+                error = std::numeric_limits<float>::max(); // straddles the grid edge: must split
+            }
+            errors[middle] = std::max(errors[middle], error);
+
+            if (i < numParentTriangles) {
+                size_t left = static_cast<size_t>((ay + cy) >> 1) * gridSize + ((ax + cx) >> 1);
+                size_t right = static_cast<size_t>((by + cy) >> 1) * gridSize + ((bx + cx) >> 1);
+                errors[middle] = std::max(errors[middle], std::max(errors[left], errors[right]));
+            }
+        }
+    }
+
+    // Largest vertical distance between the triangle's plane and any real grid sample it covers
+    float triangleError(int ax, int ay, int bx, int by, int cx, int cy) const {
+        float ha = height(ax, ay), hb = height(bx, by), hc = height(cx, cy);
+        int area = edge(ax, ay, bx, by, cx, cy);
+        int x1 = std::min(std::max(ax, std::max(bx, cx)), width - 1);
+        int y1 = std::min(std::max(ay, std::max(by, cy)), length - 1);
+        float error = 0.0f;
+        for (int y = std::min(ay, std::min(by, cy)); y <= y1; y++) {
+            for (int x = std::min(ax, std::min(bx, cx)); x <= x1; x++) {
+                int wa = edge(bx, by, cx, cy, x, y);
+                int wb = edge(cx, cy, ax, ay, x, y);
+                int wc = edge(ax, ay, bx, by, x, y);
+                if ((area > 0 && (wa < 0 || wb < 0 || wc < 0)) || (area < 0 && (wa > 0 || wb > 0 || wc > 0))) {
+                    continue;
+                }
+                float interpolated = (wa * ha + wb * hb + wc * hc) / area;
+                error = std::max(error, std::fabs(interpolated - height(x, y)));
+            }
+        }
+        return error;
+    }
+
+    static int edge(int ax, int ay, int bx, int by, int px, int py) {
+        return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+    }
+
+    // Decodes a triangle id into its corners: the lowest bit picks one of the two root halves and each
+    // higher bit below the leading one picks a child. a and b end the hypotenuse, c is the right angle.
+    void triangleCoords(int id, int& ax, int& ay, int& bx, int& by, int& cx, int& cy) const {
+        if (id & 1) {
+            ax = ay = cy = 0;
+            bx = by = cx = tileSize;
+        }
+        else {
+            ax = ay = cy = tileSize;
+            bx = by = cx = 0;
+        }
+        while ((id >>= 1) > 1) {
+            int mx = (ax + bx) >> 1;
+            int my = (ay + by) >> 1;
+            if (id & 1) {
+                bx = ax; by = ay;
+                ax = cx; ay = cy;
+            }
+            else {
+                ax = bx; ay = by;
+                bx = cx; by = cy;
+            }
+            cx = mx; cy = my;
+        }
+    }
+
+    // Depth-first descent; emitting in this order keeps neighbouring triangles close in the index
+    // buffer, and vertices are numbered on first use so fetches stay close too
+    void processTriangle(TerrainMesh& mesh, std::vector<int>& vertexIndex, float maxError,
+        int ax, int ay, int bx, int by, int cx, int cy) const {
+        if (outside(std::min(ax, std::min(bx, cx)), std::min(ay, std::min(by, cy)))) {
+            return;
+        }
+        int mx = (ax + bx) >> 1;
+        int my = (ay + by) >> 1;
+        if (std::abs(ax - cx) + std::abs(ay - cy) > 1 && errors[static_cast<size_t>(my) * gridSize + mx] > maxError) {
+            processTriangle(mesh, vertexIndex, maxError, cx, cy, ax, ay, mx, my);
+            processTriangle(mesh, vertexIndex, maxError, bx, by, cx, cy, mx, my);
+            return;
+        }
+        mesh.indices.push_back(vertex(mesh, vertexIndex, ax, ay));
+        mesh.indices.push_back(vertex(mesh, vertexIndex, bx, by));
+        mesh.indices.push_back(vertex(mesh, vertexIndex, cx, cy));
+    }
+
+    unsigned int vertex(TerrainMesh& mesh, std::vector<int>& vertexIndex, int x, int y) const {
+        size_t sample = static_cast<size_t>(y) * width + x;
+        if (vertexIndex[sample] < 0) {
+            vertexIndex[sample] = static_cast<int>(mesh.vertexCount());
+            mesh.vertices.insert(mesh.vertices.end(), &textureData[sample * 3], &textureData[sample * 3] + 3);
+        }
+        return static_cast<unsigned int>(vertexIndex[sample]);
+    }
+};
+
+#endif
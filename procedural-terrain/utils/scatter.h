@@ -0,0 +1,266 @@
+#ifndef SCATTER_H
+#define SCATTER_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <limits>
+#include <random>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "heightfield.h"
+
+
+// Where objects may go and how they vary
+struct ScatterSettings {
+    float radius = 0.2f;            // minimum distance between any two instances (world units)
+    float minHeight = 0.0f;         // terrain height range instances may stand on
+    float maxHeight = std::numeric_limits<float>::max();
+    float maxSlope = 1.0f;          // rise over run; 1 is 45 degrees
+    float minScale = 1.0f;
+    float maxScale = 1.0f;
+    float tileSize = 4.0f;          // side of a sampling and culling tile (world units), at least 4 * radius
+    uint32_t seed = 1;
+    int attempts = 30;              // candidates tried around each sample before it is retired
+};
+
+
+// Per-instance transforms in structure-of-arrays form. Each tile's instances are contiguous and in
+// random order, so the first n of a tile are spread evenly over it (see ScatterRenderer's thinning)
+struct ScatterInstances {
+    struct Tile {
+        size_t first = 0;
+        size_t count = 0;
+        glm::vec3 boundsMin; // of the instance origins
+        glm::vec3 boundsMax;
+    };
+
+    std::vector<float> x, y, z; // position on the terrain
+    std::vector<float> scale;
+    std::vector<float> yaw;     // radians about +y
+    std::vector<Tile> tiles;    // row-major, tilesX per row
+    int tilesX = 0;
+    int tilesZ = 0;
+
+    size_t size() const { return x.size(); }
+};
+
+
+/*
+* Poisson-disk scattering over a HeightField: every instance is at least settings.radius from every
+* other, on terrain within the height and slope limits.
+
+The map is cut into tiles, each filled by Bridson's algorithm. Tiles run in four phases by the
+parity of their coordinates: two tiles of one phase are a whole tile apart, further than radius,
+so they can be filled in parallel while sharing one acceptance grid, and a tile only ever sees
+neighbours from earlier phases. Each tile draws from its own generator seeded from (seed, tile),
+so the result is the same for any thread count.
+*/
+class PoissonScatter {
+public:
+    // threads = 0 uses every hardware thread
+    static ScatterInstances generate(const HeightField& field, const ScatterSettings& settings, int threads = 0) {
+        Sampler sampler(field, settings);
+        sampler.run(threads);
+        return sampler.collect();
+    }
+
+private:
+    struct Point { float x, z; };
+
+    class Sampler {
+    public:
+        Sampler(const HeightField& field, const ScatterSettings& settings) : field(field), settings(settings) {
+            field.extent(minX, minZ, maxX, maxZ);
+            radius = std::max(settings.radius, 1e-4f);
+            // a grid cell (side radius / sqrt 2) holds at most one sample; tiles are whole cells
+            cellsPerTile = std::max(4, static_cast<int>(std::ceil(std::max(settings.tileSize, 4.0f * radius) / (radius / std::sqrt(2.0f)))));
+            tileSize = std::max(settings.tileSize, 4.0f * radius);
+            cellSize = tileSize / cellsPerTile;
+            tilesX = std::max(1, static_cast<int>(std::ceil((maxX - minX) / tileSize)));
+            tilesZ = std::max(1, static_cast<int>(std::ceil((maxZ - minZ) / tileSize)));
+            gridX = tilesX * cellsPerTile;
+            gridZ = tilesZ * cellsPerTile;
+            const float empty = std::numeric_limits<float>::quiet_NaN(); // NaN never compares closer than radius
+            grid.assign(static_cast<size_t>(gridX) * gridZ, Point{ empty, empty });
+            tilePoints.resize(static_cast<size_t>(tilesX) * tilesZ);
+        }
+
+        void run(int threads) {
+            if (threads <= 0) {
+                threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+            }
+            for (int phase = 0; phase < 4; phase++) {
+                std::vector<int> tiles;
+                for (int tz = phase >> 1; tz < tilesZ; tz += 2) {
+                    for (int tx = phase & 1; tx < tilesX; tx += 2) {
+                        tiles.push_back(tz * tilesX + tx);
+                    }
+                }
+                // tiles vary a lot in cost (slopes, heights), so hand them out one at a time
+                std::atomic<size_t> next(0);
+                auto work = [&]() {
+                    for (size_t k = next++; k < tiles.size(); k = next++) {
+                        fillTile(tiles[k]);
+                    }
+                };
+                int count = static_cast<int>(std::min<size_t>(threads, tiles.size()));
+                std::vector<std::thread> workers;
+                for (int t = 1; t < count; t++) {
+                    workers.emplace_back(work);
+                }
+                work();
+                for (auto& worker : workers) {
+                    worker.join();
+                }
+            }
+        }
+
+        ScatterInstances collect() const {
+            ScatterInstances out;
+            out.tilesX = tilesX;
+            out.tilesZ = tilesZ;
+            size_t total = 0;
+            for (const auto& points : tilePoints) {
+                total += points.size();
+            }
+            out.x.reserve(total);
+            out.y.reserve(total);
+            out.z.reserve(total);
+            out.scale.reserve(total);
+            out.yaw.reserve(total);
+            out.tiles.resize(tilePoints.size());
+
+            for (size_t t = 0; t < tilePoints.size(); t++) {
+                ScatterInstances::Tile& tile = out.tiles[t];
+                tile.first = out.x.size();
+                tile.count = tilePoints[t].size();
+                tile.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+                tile.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+
+                // per-instance variation from the tile's own generator too, so it is just as repeatable
+                std::mt19937 rng(tileSeed(static_cast<int>(t)) ^ 0x9e3779b9u);
+                // Bridson emits points in growth order; shuffled, any prefix of a tile is an even thinning
+                std::vector<Point> points = tilePoints[t];
+                for (size_t k = points.size(); k > 1; k--) {
+                    std::swap(points[k - 1], points[rng() % k]);
+                }
+                for (const Point& p : points) {
+                    float h = field.height(p.x, p.z);
+                    out.x.push_back(p.x);
+                    out.y.push_back(h);
+                    out.z.push_back(p.z);
+                    out.scale.push_back(settings.minScale + (settings.maxScale - settings.minScale) * unit(rng));
+                    out.yaw.push_back(unit(rng) * 6.28318531f);
+                    tile.boundsMin = glm::min(tile.boundsMin, glm::vec3(p.x, h, p.z));
+                    tile.boundsMax = glm::max(tile.boundsMax, glm::vec3(p.x, h, p.z));
+                }
+            }
+            return out;
+        }
+
+    private:
+        const HeightField& field;
+        const ScatterSettings& settings;
+        float minX, minZ, maxX, maxZ;
+        float radius;
+        float tileSize;
+        float cellSize;
+        int cellsPerTile;
+        int tilesX, tilesZ;
+        int gridX, gridZ;
+        std::vector<Point> grid; // one slot per cell, written only by the cell's own tile
+        std::vector<std::vector<Point>> tilePoints;
+
+        static float unit(std::mt19937& rng) {
+            return (rng() >> 8) * (1.0f / 16777216.0f); // [0, 1), the same on every standard library
+        }
+
+        uint32_t tileSeed(int tile) const {
+            // splitmix-style mix of the seed and the tile index
+            uint64_t z = (static_cast<uint64_t>(settings.seed) << 32) + static_cast<uint32_t>(tile) + 0x9e3779b97f4a7c15ull;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return static_cast<uint32_t>(z ^ (z >> 31));
+        }
+
+        bool terrainAllows(float x, float z) const {
+            float h = field.height(x, z);
+            if (h < settings.minHeight || h > settings.maxHeight) {
+                return false;
+            }
+            glm::vec3 n = field.normal(x, z);
+            // slope = tan(angle from vertical normal) = horizontal / vertical component
+            return std::sqrt(n.x * n.x + n.z * n.z) <= settings.maxSlope * n.y;
+        }
+
+        bool farFromOthers(float x, float z, int ci, int cj) const {
+            float r2 = radius * radius;
+            for (int i = std::max(ci - 2, 0); i <= std::min(ci + 2, gridX - 1); i++) {
+                for (int j = std::max(cj - 2, 0); j <= std::min(cj + 2, gridZ - 1); j++) {
+                    const Point& q = grid[static_cast<size_t>(j) * gridX + i];
+                    float dx = q.x - x, dz = q.z - z;
+                    if (dx * dx + dz * dz < r2) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        void fillTile(int tile) {
+            const int tx = tile % tilesX, tz = tile / tilesX;
+            const float x0 = minX + tx * tileSize, z0 = minZ + tz * tileSize;
+            const float x1 = std::min(x0 + tileSize, maxX), z1 = std::min(z0 + tileSize, maxZ);
+            std::vector<Point>& points = tilePoints[tile];
+            std::vector<Point> active;
+            std::mt19937 rng(tileSeed(tile));
+
+            auto tryAdd = [&](float x, float z) {
+                if (!(x >= x0 && x < x1 && z >= z0 && z < z1)) {
+                    return false;
+                }
+                int ci = std::min(static_cast<int>((x - minX) / cellSize), gridX - 1);
+                int cj = std::min(static_cast<int>((z - minZ) / cellSize), gridZ - 1);
+                if (!farFromOthers(x, z, ci, cj) || !terrainAllows(x, z)) {
+                    return false;
+                }
+                grid[static_cast<size_t>(cj) * gridX + ci] = { x, z };
+                points.push_back({ x, z });
+                active.push_back({ x, z });
+                return true;
+            };
+
+            // Seed with random darts, grow from each seed until nothing more fits, and repeat until the
+            // darts stop finding room (terrain limits can split a tile into separate regions)
+            for (;;) {
+                bool seeded = false;
+                for (int a = 0; a < settings.attempts && !seeded; a++) {
+                    seeded = tryAdd(x0 + (x1 - x0) * unit(rng), z0 + (z1 - z0) * unit(rng));
+                }
+                if (!seeded) {
+                    break;
+                }
+                while (!active.empty()) {
+                    size_t pick = rng() % active.size();
+                    Point p = active[pick];
+                    bool placed = false;
+                    for (int a = 0; a < settings.attempts && !placed; a++) {
+                        // uniform over the annulus [radius, 2 radius]
+                        float angle = unit(rng) * 6.28318531f;
+                        float distance = radius * std::sqrt(1.0f + 3.0f * unit(rng));
+                        placed = tryAdd(p.x + distance * std::cos(angle), p.z + distance * std::sin(angle));
+                    }
+                    if (!placed) {
+                        active[pick] = active.back();
+                        active.pop_back();
+                    }
+                }
+            }
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef SCATTER_RENDERER_H
+#define SCATTER_RENDERER_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "scatter.h"
+#include "frustum.h"
+
+
+/*
+* Draws ScatterInstances with instanced rendering (see instance.vs): one small mesh, and one buffer
+* per instance attribute.
+
+Culling is per scatter tile. Because a tile's instances are contiguous and tiles are stored row by
+row, the visible tiles form a few runs of consecutive instances; each run is drawn by pointing
+the per-instance attributes at its first instance and issuing one glDrawElementsInstanced, so
+nothing is copied or rebuilt per frame.
+
+Beyond fullDensityDistance a tile draws only a prefix of its instances, shrinking with the square of
+the distance so the density on screen stays about the same. Instances are shuffled within their
+tile, so the prefix is an even thinning rather than one corner of the tile.
+*/
+class ScatterRenderer {
+public:
+    explicit ScatterRenderer(const ScatterInstances& instances) : tiles(instances.tiles) {
+        // A three-sided pyramid, base radius 0.35 and height 1 before scaling: a tree or a rock
+        const float vertices[] = {
+            0.35f, 0.0f, 0.0f,
+            -0.175f, 0.0f, 0.303f,
+            -0.175f, 0.0f, -0.303f,
+            0.0f, 1.0f, 0.0f,
+        };
+        const unsigned int indices[] = { 0, 2, 3, 2, 1, 3, 1, 0, 3 };
+        indexCount = sizeof(indices) / sizeof(indices[0]);
+
+        // tile bounds hold instance origins; the mesh fits within one unit of its origin, times the scale
+        reach = 0.0f;
+        for (float s : instances.scale) {
+            reach = std::max(reach, s);
+        }
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &meshVBO);
+        glGenBuffers(1, &EBO);
+        glGenBuffers(ATTRIBUTES, instanceVBOs);
+        glBindVertexArray(VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, meshVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+        const std::vector<float>* columns[ATTRIBUTES] = { &instances.x, &instances.y, &instances.z, &instances.scale, &instances.yaw };
+        for (int a = 0; a < ATTRIBUTES; a++) {
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBOs[a]);
+            glBufferData(GL_ARRAY_BUFFER, columns[a]->size() * sizeof(float), columns[a]->data(), GL_STATIC_DRAW);
+            glEnableVertexAttribArray(1 + a);
+            glVertexAttribDivisor(1 + a, 1);
+        }
+        glBindVertexArray(0);
+    }
+
+    ~ScatterRenderer() {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &meshVBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(ATTRIBUTES, instanceVBOs);
+    }
+
+    ScatterRenderer(const ScatterRenderer&) = delete;
+    ScatterRenderer& operator=(const ScatterRenderer&) = delete;
+
+    // Draws the tiles inside the frustum (with instance.vs bound); returns how many instances were drawn.
+    // fullDensityDistance <= 0 draws every instance of every visible tile.
+    size_t draw(const Frustum& frustum, const glm::vec3& eye, float fullDensityDistance) {
+        glBindVertexArray(VAO);
+        size_t drawn = 0;
+        size_t runFirst = 0, runCount = 0;
+        for (const ScatterInstances::Tile& tile : tiles) {
+            if (tile.count == 0) {
+                continue;
+            }
+            glm::vec3 boxMin = tile.boundsMin - glm::vec3(reach), boxMax = tile.boundsMax + glm::vec3(reach);
+            size_t count = frustum.intersects(boxMin, boxMax) ? thinnedCount(tile.count, eye, boxMin, boxMax, fullDensityDistance) : 0;
+            if (count > 0 && runCount > 0 && runFirst + runCount == tile.first) {
+                runCount += count; // extends the current run
+                continue;
+            }
+            drawn += drawRun(runFirst, runCount);
+            runFirst = tile.first;
+            // a thinned tile ends its run: the rest of its instances lie between it and the next tile
+            runCount = count;
+            if (count < tile.count) {
+                drawn += drawRun(runFirst, runCount);
+                runCount = 0;
+            }
+        }
+        drawn += drawRun(runFirst, runCount);
+        glBindVertexArray(0);
+        return drawn;
+    }
+
+private:
+    static const int ATTRIBUTES = 5; // x, y, z, scale, yaw at locations 1-5
+
+    std::vector<ScatterInstances::Tile> tiles;
+    float reach;
+    unsigned int VAO, meshVBO, EBO;
+    unsigned int instanceVBOs[ATTRIBUTES];
+    size_t indexCount;
+
+    static size_t thinnedCount(size_t count, const glm::vec3& eye, const glm::vec3& boxMin, const glm::vec3& boxMax, float fullDensityDistance) {
+        if (fullDensityDistance <= 0.0f) {
+            return count;
+        }
+        glm::vec3 nearest = glm::min(glm::max(eye, boxMin), boxMax);
+        float distance = glm::length(nearest - eye);
+        if (distance <= fullDensityDistance) {
+            return count;
+        }
+        float keep = (fullDensityDistance * fullDensityDistance) / (distance * distance);
+        return static_cast<size_t>(std::ceil(count * keep));
+    }
+
+    size_t drawRun(size_t first, size_t count) {
+        if (count == 0) {
+            return 0;
+        }
+        for (int a = 0; a < ATTRIBUTES; a++) {
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBOs[a]);
+            glVertexAttribPointer(1 + a, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)(first * sizeof(float)));
+        }
+        glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(indexCount), GL_UNSIGNED_INT, (void*)0, static_cast<GLsizei>(count));
+        return count;
+    }
+};
+
+#endif
@@ -7,6 +7,15 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <iomanip>
+#include <iterator>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -16,17 +25,27 @@ private:
 	unsigned int shaderProgramID;
 	std::string vertexCodeString;
 	std::string fragmentCodeString;
+	std::string vertexPath;
+	std::string fragmentPath;
+
+	// hot reload state, shared with the watcher thread
+	std::thread watcher;
+	std::atomic<bool> watching{ false };
+	std::atomic<bool> pendingReload{ false };
+	std::mutex pendingMutex;
+	std::string pendingVertexCode;
+	std::string pendingFragmentCode;
 public:
 	//std::string future shaders
 
 	/*
 	* General process:
 	1. Retrieve shader files and save to strings
-	2. Compile the shaders
-	3. Link the shaders
+	2. Load the linked program from the binary cache if the driver accepts it, otherwise
+	   compile and link the shaders and store the result in the cache
 	*/
 
-	Shader(const char* vertexFile, const char* fragmentFile) {
+	Shader(const char* vertexFile, const char* fragmentFile) : vertexPath(vertexFile), fragmentPath(fragmentFile) {
 		/*
 			Links a vertex and fragment shader to a shader program, and saves that
 			program as private variable shaderProgramID
@@ -63,49 +82,90 @@ public:
 			std::cerr << "Exception: " << e.what() << std::endl;
 		}
 
-		/* Part 2. Compile the shaders*/
-		// 2.1 Setup shader vars
-		const char* vertexShaderSource = vertexCodeString.c_str();
-		const char* fragmentShaderSource = fragmentCodeString.c_str();
-		int success;
-		char infoLog[512];
+		/* Part 2. Reuse a cached program binary, or compile and link from source*/
+		shaderProgramID = loadProgram();
+	}
 
-		// 2.2 Compile shaders and check for failure
-		unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-		glCompileShader(vertexShader);
+	~Shader() {
+		stopWatching();
+	}
 
-		unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-		glCompileShader(fragmentShader);
+	/*
 
-		glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-		if (!success) // Vertex
-		{
-			glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-			std::cout << "Error: Vertex shader linking failed!\n" << infoLog << std::endl;
+	Program binary cache and hot reload
+
+	*/
+
+	void watchFiles(int intervalMs = 500) {
+		/*
+			Starts a background thread that re-reads both shader files every intervalMs and
+			stages their contents when they change. GL calls must stay on the context's thread,
+			so the recompile itself happens in reloadIfChanged().
+		*/
+		if (watching) {
+			return;
 		}
-		glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-		if (!success) // Fragment
-		{
-			glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-			std::cout << "Error: Fragment shader linking failed@\n" << infoLog << std::endl;
+		watching = true;
+		uint64_t initialKey = hashSources(vertexCodeString, fragmentCodeString);
+		watcher = std::thread([this, intervalMs, initialKey]() {
+			uint64_t lastKey = initialKey;
+			while (watching) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+				std::string vertexCode, fragmentCode;
+				if (!readFile(vertexPath, vertexCode) || !readFile(fragmentPath, fragmentCode)) {
+					continue; // mid-save or missing; try again next tick
+				}
+				uint64_t key = hashSources(vertexCode, fragmentCode);
+				if (key != lastKey) {
+					lastKey = key;
+					std::lock_guard<std::mutex> lock(pendingMutex);
+					pendingVertexCode = vertexCode;
+					pendingFragmentCode = fragmentCode;
+					pendingReload = true;
+				}
+			}
+		});
+	}
+
+	void stopWatching() {
+		if (watching) {
+			watching = false;
+			watcher.join();
 		}
+	}
 
-		/* Part 3. Shader linking*/
-		shaderProgramID = glCreateProgram();
-		glAttachShader(shaderProgramID, vertexShader);
-		glAttachShader(shaderProgramID, fragmentShader);
-		glLinkProgram(shaderProgramID);
+	bool reloadIfChanged() {
+		/*
+			Call once per frame on the GL thread. Swaps in the program built from changed files
+			and returns true; a program that fails to build is discarded and the old one kept.
+		*/
+		if (!pendingReload) {
+			return false;
+		}
+		std::string previousVertexCode = vertexCodeString;
+		std::string previousFragmentCode = fragmentCodeString;
+		{
+			std::lock_guard<std::mutex> lock(pendingMutex);
+			vertexCodeString.swap(pendingVertexCode);
+			fragmentCodeString.swap(pendingFragmentCode);
+			pendingReload = false;
+		}
 
-		glGetProgramiv(shaderProgramID, GL_LINK_STATUS, &success);
-		if (!success) {
-			glGetProgramInfoLog(shaderProgramID, 512, NULL, infoLog);
-			std::cout << "Error: Shader linking failed! \n" << infoLog << std::endl;
+		bool linked;
+		unsigned int programID = loadProgram(&linked);
+		if (!linked) {
+			std::cout << "Shader reload failed, keeping the previous program" << std::endl;
+			glDeleteProgram(programID);
+			vertexCodeString = previousVertexCode;
+			fragmentCodeString = previousFragmentCode;
+			return false;
 		}
-		glDeleteShader(vertexShader);
-		glDeleteShader(fragmentShader);
+		std::cout << "Shader reloaded" << std::endl;
+		glDeleteProgram(shaderProgramID);
+		shaderProgramID = programID;
+		return true;
 	}
+
 	/*
 
 	General use utils
@@ -126,13 +186,13 @@ public:
 	void setBool(std::string loc, bool value)
 	{
 		GLint location = validateLocation(loc.c_str());
-		glUniform1f(location, int(value));
+		glUniform1i(location, int(value));
 	}
 	// ------------------------------------------------------------------------
 	void setInt(std::string loc, int value)
 	{
 		GLint location = validateLocation(loc.c_str());
-		glUniform1f(location, value);
+		glUniform1i(location, value);
 	}
 	// ------------------------------------------------------------------------
 	void setFloat(std::string loc, float value)
@@ -178,6 +238,194 @@ public:
 		}
 		return location;
 	}
+private:
+	unsigned int loadProgram(bool* linkedOut = NULL) {
+		/*
+			Cache files are keyed by a hash of both sources and the driver's vendor, renderer and
+			version strings, so an edit or a driver update simply misses. A binary the driver
+			rejects anyway falls back to compiling from source, which rewrites the entry.
+		*/
+		bool linked = false;
+		uint64_t key = hashSources(vertexCodeString, fragmentCodeString) ^ driverHash();
+		unsigned int programID = binaryCacheSupported() ? loadCachedProgram(key) : 0;
+		if (programID != 0) {
+			linked = true;
+		}
+		else {
+			programID = compileProgram(linked);
+			if (linked && binaryCacheSupported()) {
+				saveCachedProgram(programID, key);
+			}
+		}
+		if (linkedOut) {
+			*linkedOut = linked;
+		}
+		return programID;
+	}
+
+	unsigned int compileProgram(bool& linked) {
+		/* Part 2. Compile the shaders*/
+		// 2.1 Setup shader vars
+		const char* vertexShaderSource = vertexCodeString.c_str();
+		const char* fragmentShaderSource = fragmentCodeString.c_str();
+		int success;
+		char infoLog[512];
+
+		// 2.2 Compile shaders and check for failure
+		bool compiled = true;
+		unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
+		glCompileShader(vertexShader);
+
+		unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
+		glCompileShader(fragmentShader);
+
+		glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+		if (!success) // Vertex
+		{
+			glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
+			std::cout << "Error: Vertex shader linking failed!\n" << infoLog << std::endl;
+			compiled = false;
+		}
+		glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+		if (!success) // Fragment
+		{
+			glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
+			std::cout << "Error: Fragment shader linking failed@\n" << infoLog << std::endl;
+			compiled = false;
+		}
+
+		/* Part 3. Shader linking*/
+		unsigned int programID = glCreateProgram();
+		glAttachShader(programID, vertexShader);
+		glAttachShader(programID, fragmentShader);
+#ifdef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+		if (binaryCacheSupported()) {
+			glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+#endif
+		glLinkProgram(programID);
+
+		glGetProgramiv(programID, GL_LINK_STATUS, &success);
+		if (!success) {
+			glGetProgramInfoLog(programID, 512, NULL, infoLog);
+			std::cout << "Error: Shader linking failed! \n" << infoLog << std::endl;
+		}
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		linked = compiled && success != 0;
+		return programID;
+	}
+
+	static bool binaryCacheSupported() {
+#ifdef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+#else
+		return false;
+#endif
+	}
+
+	static std::string cachePath(uint64_t key) {
+		std::ostringstream path;
+		path << "shader_cache_" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+		return path.str();
+	}
+
+	unsigned int loadCachedProgram(uint64_t key) {
+#ifdef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+		std::ifstream in(cachePath(key), std::ios::binary);
+		if (!in.is_open()) {
+			return 0;
+		}
+		GLenum format = 0;
+		in.read(reinterpret_cast<char*>(&format), sizeof(format));
+		std::vector<char> binary((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		if (!in.good() && !in.eof()) {
+			return 0;
+		}
+
+		// a format this driver does not list would only raise GL_INVALID_ENUM
+		GLint formatCount = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		std::vector<GLint> formats(formatCount);
+		glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+		if (std::find(formats.begin(), formats.end(), static_cast<GLint>(format)) == formats.end()) {
+			std::cout << "Cached shader binary rejected, compiling from source" << std::endl;
+			return 0;
+		}
+
+		unsigned int programID = glCreateProgram();
+		glProgramBinary(programID, format, binary.data(), static_cast<GLsizei>(binary.size()));
+		int success;
+		glGetProgramiv(programID, GL_LINK_STATUS, &success);
+		if (!success) {
+			std::cout << "Cached shader binary rejected, compiling from source" << std::endl;
+			glDeleteProgram(programID);
+			return 0;
+		}
+		return programID;
+#else
+		return 0;
+#endif
+	}
+
+	void saveCachedProgram(unsigned int programID, uint64_t key) {
+#ifdef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+		GLint length = 0;
+		glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) {
+			return;
+		}
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(programID, length, NULL, &format, binary.data());
+
+		std::ofstream out(cachePath(key), std::ios::binary);
+		if (!out.is_open()) {
+			std::cerr << "Could not write shader cache " << cachePath(key) << std::endl;
+			return;
+		}
+		out.write(reinterpret_cast<const char*>(&format), sizeof(format));
+		out.write(binary.data(), binary.size());
+#endif
+	}
+
+	static uint64_t fnv1a(const std::string& data, uint64_t hash = 14695981039346656037ull) {
+		for (unsigned char c : data) {
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	static uint64_t hashSources(const std::string& vertexCode, const std::string& fragmentCode) {
+		// the separator keeps "ab" + "c" and "a" + "bc" apart
+		return fnv1a(fragmentCode, fnv1a(std::string(1, '\0'), fnv1a(vertexCode)));
+	}
+
+	static uint64_t driverHash() {
+		std::string driver;
+		for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+			const GLubyte* value = glGetString(name);
+			driver += value ? reinterpret_cast<const char*>(value) : "";
+			driver += '\n';
+		}
+		return fnv1a(driver);
+	}
+
+	static bool readFile(const std::string& path, std::string& contents) {
+		std::ifstream in(path, std::ios::binary);
+		if (!in.is_open()) {
+			return false;
+		}
+		std::stringstream buffer;
+		buffer << in.rdbuf();
+		contents = buffer.str();
+		return true;
+	}
 };
 
 #endif
\ No newline at end of file
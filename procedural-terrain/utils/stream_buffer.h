@@ -0,0 +1,172 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <glad/glad.h>
+
+
+/*
+* Ring of GL buffers for data that is rewritten at runtime (streamed terrain tiles, indices).
+
+map() hands out the next buffer in the ring as a plain write-only pointer, which any thread may fill,
+e.g. the generator threads of Perlin::generateHeightMap writing straight into it. unmap() (GL thread)
+publishes it as current(). After issuing the draws that read current(), call fence(): map() will not
+hand that buffer out again until the GPU is past them, so nothing is written under an in-flight draw
+and the driver never has to stall or copy to keep an older version alive.
+
+With ARB_buffer_storage (core in 4.4) every buffer is mapped once, persistently and coherently, at
+construction. Without it each map() is an unsynchronized glMapBufferRange that invalidates the old
+contents; the fences give the same guarantee. Separate buffer objects rather than ranges of one are
+used so that, on that path, drawing from current() is legal while the next buffer is still mapped.
+*/
+class StreamBuffer {
+public:
+    static const int SEGMENTS = 3;
+
+    StreamBuffer(GLenum target, size_t size) : target(target), bufferSize(size) {
+        persistentMapping = bufferStorageSupported();
+        glGenBuffers(SEGMENTS, buffers);
+        for (int s = 0; s < SEGMENTS; s++) {
+            fences[s] = 0;
+            pointers[s] = nullptr;
+            glBindBuffer(target, buffers[s]);
+#ifdef GL_MAP_PERSISTENT_BIT
+            if (persistentMapping) {
+                const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glBufferStorage(target, size, NULL, flags);
+                pointers[s] = glMapBufferRange(target, 0, size, flags);
+                if (pointers[s] == NULL) {
+                    glDeleteBuffers(SEGMENTS, buffers);
+                    throw std::runtime_error("Failed to persistently map stream buffer");
+                }
+                continue;
+            }
+#endif
+            glBufferData(target, size, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(target, 0);
+    }
+
+    ~StreamBuffer() {
+        for (int s = 0; s < SEGMENTS; s++) {
+            if (fences[s]) {
+                glDeleteSync(fences[s]);
+            }
+        }
+        // deleting a buffer unmaps it
+        glDeleteBuffers(SEGMENTS, buffers);
+    }
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    /*
+    * Next buffer of the ring, once the GPU has finished every command fenced on it. The returned
+    * size() bytes are write-only and stay valid until unmap(); GL thread only, but the memory may
+    * be filled from any thread.
+    */
+    void* map() {
+        if (mapped >= 0) {
+            throw std::runtime_error("StreamBuffer::map called twice without unmap");
+        }
+        mapped = (published + 1) % SEGMENTS;
+        waitFor(mapped);
+        if (persistentMapping) {
+            return pointers[mapped];
+        }
+        glBindBuffer(target, buffers[mapped]);
+        void* pointer = glMapBufferRange(target, 0, bufferSize,
+            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (pointer == NULL) {
+            mapped = -1;
+            throw std::runtime_error("Failed to map stream buffer");
+        }
+        return pointer;
+    }
+
+    // Publishes the buffer filled since map() as current(). GL thread only, after every writer is done.
+    // Returns false if the driver lost the contents while mapped (they must be written again).
+    bool unmap() {
+        if (mapped < 0) {
+            return false;
+        }
+        int segment = mapped;
+        mapped = -1;
+        if (!persistentMapping) {
+            glBindBuffer(target, buffers[segment]);
+            if (glUnmapBuffer(target) == GL_FALSE) {
+                std::cout << "Stream buffer contents lost while mapped" << std::endl;
+                return false;
+            }
+        }
+        published = segment;
+        return true;
+    }
+
+    // Call after issuing the draws that read current(); replaces its previous fence
+    void fence() {
+        if (published < 0) {
+            return;
+        }
+        if (fences[published]) {
+            glDeleteSync(fences[published]);
+        }
+        fences[published] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // Buffer published by the last unmap(); 0 before the first
+    unsigned int current() const { return published >= 0 ? buffers[published] : 0; }
+    size_t size() const { return bufferSize; }
+    bool persistent() const { return persistentMapping; }
+
+private:
+    GLenum target;
+    size_t bufferSize;
+    bool persistentMapping;
+    unsigned int buffers[SEGMENTS];
+    GLsync fences[SEGMENTS];
+    void* pointers[SEGMENTS];
+    int published = -1;
+    int mapped = -1;
+
+    void waitFor(int segment) {
+        if (!fences[segment]) {
+            return;
+        }
+        // flush on the first wait so the fence itself is sure to reach the GPU
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        for (;;) {
+            GLenum result = glClientWaitSync(fences[segment], flags, 1000000); // 1 ms
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) {
+                break;
+            }
+            flags = 0;
+        }
+        glDeleteSync(fences[segment]);
+        fences[segment] = 0;
+    }
+
+    static bool bufferStorageSupported() {
+#ifdef GL_MAP_PERSISTENT_BIT
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 4)) {
+            return true;
+        }
+        GLint extensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+        for (GLint e = 0; e < extensions; e++) {
+            const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, e));
+            if (name && std::strcmp(name, "GL_ARB_buffer_storage") == 0) {
+                return true;
+            }
+        }
+#endif
+        return false;
+    }
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include <glad/glad.h>
+#include "heightmap.h"
 
 
 class Texture {
@@ -25,6 +26,25 @@ public:
         glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
         return textureID;
 	}
+
+	// 16-bit normalized heights; the shader samples [0, 1] and applies tile.scale * 65535 and tile.offset
+	unsigned int generate2DArray(const QuantizedHeightMap& tile) {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, tile.width, tile.length, 0, GL_RED, GL_UNSIGNED_SHORT, tile.heights.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return textureID;
+	}
 };
 
 #endif
\ No newline at end of file
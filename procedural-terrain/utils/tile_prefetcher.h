@@ -0,0 +1,343 @@
+#ifndef TILE_PREFETCHER_H
+#define TILE_PREFETCHER_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "heightmap.h"
+#include "frustum.h"
+#include "camera.h"
+
+
+// Tile coordinates: x counts tiles along world x, z along world z
+struct TileKey {
+    int x;
+    int z;
+
+    bool operator==(const TileKey& other) const { return x == other.x && z == other.z; }
+};
+
+struct TileKeyHash {
+    size_t operator()(const TileKey& key) const {
+        return std::hash<uint64_t>()((static_cast<uint64_t>(static_cast<uint32_t>(key.x)) << 32) | static_cast<uint32_t>(key.z));
+    }
+};
+
+
+/*
+* Generates terrain tiles ahead of the camera on worker threads.
+
+Every update() extrapolates the camera over the next few seconds: position from its smoothed
+velocity, view direction from its smoothed yaw and pitch rates. Each tile gets the earliest time
+a predicted view frustum reaches it, and is queued with that as its deadline; workers always take
+the earliest deadline, so tiles about to appear are generated before tiles that merely might.
+A small ring around the camera is also kept, at a lower priority, so that turning faster than the
+prediction does not expose missing tiles. Queued tiles the prediction no longer reaches are
+cancelled, and resident tiles well out of range are evicted.
+
+A tile is counted as a hit when it enters the actual frustum already resident, and as a miss
+when it does not (it would pop in).
+*/
+class TilePrefetcher {
+public:
+    using Generator = std::function<QuantizedHeightMap(int tileX, int tileZ)>;
+
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t generated = 0;
+        size_t cancelled = 0;
+
+        float hitRate() const { return hits + misses > 0 ? static_cast<float>(hits) / (hits + misses) : 1.0f; }
+    };
+
+    // Seconds ahead the camera is extrapolated, and in how many steps
+    float horizon = 2.0f;
+    int predictionSteps = 8;
+    // Tiles this far (in tiles) from the camera are kept whatever the view direction
+    float guardRadius = 2.0f;
+
+    /*
+    * Tile (x, z) covers world [originX + x * tileSize, originX + (x + 1) * tileSize] along x, and likewise
+    * along z; its heights lie in [minHeight, maxHeight]. generator is called on the worker threads.
+    * threads = 0 uses every hardware thread but one.
+    */
+    TilePrefetcher(float tileSize, float originX, float originZ, float minHeight, float maxHeight, Generator generator, int threads = 0)
+        : tileSize(tileSize), originX(originX), originZ(originZ), minHeight(minHeight), maxHeight(maxHeight), generator(std::move(generator)) {
+        if (threads <= 0) {
+            threads = static_cast<int>(std::max(2u, std::thread::hardware_concurrency()) - 1);
+        }
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back(&TilePrefetcher::work, this);
+        }
+    }
+
+    ~TilePrefetcher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    TilePrefetcher(const TilePrefetcher&) = delete;
+    TilePrefetcher& operator=(const TilePrefetcher&) = delete;
+
+    // Once per frame, with the same projection parameters the frame is drawn with; time in seconds
+    void update(const Camera& camera, float aspect, float nearPlane, float farPlane, float time) {
+        trackMotion(camera, time);
+
+        // Predicted frusta, from now (step 0) to the horizon
+        std::vector<Frustum> predicted;
+        for (int step = 0; step <= predictionSteps; step++) {
+            float t = horizon * step / predictionSteps;
+            predicted.push_back(Frustum::fromMatrix(predictedViewProjection(camera, t, aspect, nearPlane, farPlane)));
+        }
+
+        // Every tile any predicted frustum might reach lies within this distance of the camera
+        float speed = glm::length(velocity);
+        float reach = farPlane + speed * horizon + tileSize;
+        int radius = static_cast<int>(std::ceil(reach / tileSize));
+        TileKey center = tileAt(camera.Position.x, camera.Position.z);
+
+        std::unordered_map<TileKey, float, TileKeyHash> wanted;
+        std::vector<TileKey> nowVisible;
+        for (int dx = -radius; dx <= radius; dx++) {
+            for (int dz = -radius; dz <= radius; dz++) {
+                TileKey key = { center.x + dx, center.z + dz };
+                glm::vec3 boxMin, boxMax;
+                bounds(key, boxMin, boxMax);
+                float distance = distanceTo(camera.Position, boxMin, boxMax);
+                if (distance > reach) {
+                    continue;
+                }
+                for (int step = 0; step <= predictionSteps; step++) {
+                    if (predicted[step].intersects(boxMin, boxMax)) {
+                        wanted[key] = time + horizon * step / predictionSteps;
+                        if (step == 0) {
+                            nowVisible.push_back(key);
+                        }
+                        break;
+                    }
+                }
+                if (!wanted.count(key) && distance <= guardRadius * tileSize) {
+                    // behind or beside the view: needed only if the camera turns, after what is predicted
+                    wanted[key] = time + horizon + distance / std::max(camera.MovementSpeed, 1e-3f);
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        countVisibility(nowVisible);
+
+        // Rebuild the queue from what is wanted now; anything queued but no longer wanted is cancelled
+        for (const auto& entry : pending) {
+            if (!wanted.count(entry.first)) {
+                stats.cancelled++;
+            }
+        }
+        pending.clear();
+        queue.clear();
+        for (const auto& entry : wanted) {
+            if (!resident.count(entry.first) && !inFlight.count(entry.first)) {
+                pending[entry.first] = entry.second;
+                queue.push_back({ entry.second, entry.first });
+            }
+        }
+        std::make_heap(queue.begin(), queue.end(), laterDeadline);
+
+        // Evict tiles well beyond anything that could be wanted
+        float keep = reach * 1.5f;
+        for (auto it = resident.begin(); it != resident.end();) {
+            glm::vec3 boxMin, boxMax;
+            bounds(it->first, boxMin, boxMax);
+            if (distanceTo(camera.Position, boxMin, boxMax) > keep) {
+                evicted.push_back(it->first);
+                it = resident.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        visibleTiles.swap(nowVisible);
+        if (!queue.empty()) {
+            wake.notify_all();
+        }
+    }
+
+    // Tiles that became resident / were evicted since the last call. Apply evictions first, then look
+    // completed tiles up with find(): one may have been evicted again since (find() then returns null).
+    std::vector<TileKey> takeCompleted() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<TileKey> keys;
+        keys.swap(completed);
+        return keys;
+    }
+
+    std::vector<TileKey> takeEvicted() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<TileKey> keys;
+        keys.swap(evicted);
+        return keys;
+    }
+
+    // Resident tile, or null
+    std::shared_ptr<const QuantizedHeightMap> find(const TileKey& key) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = resident.find(key);
+        return it != resident.end() ? it->second : nullptr;
+    }
+
+    // Tiles in the camera's frustum at the last update()
+    std::vector<TileKey> visible() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return visibleTiles;
+    }
+
+    Stats statistics() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+    TileKey tileAt(float x, float z) const {
+        return { static_cast<int>(std::floor((x - originX) / tileSize)), static_cast<int>(std::floor((z - originZ) / tileSize)) };
+    }
+
+    void bounds(const TileKey& key, glm::vec3& boxMin, glm::vec3& boxMax) const {
+        boxMin = glm::vec3(originX + key.x * tileSize, minHeight, originZ + key.z * tileSize);
+        boxMax = glm::vec3(boxMin.x + tileSize, maxHeight, boxMin.z + tileSize);
+    }
+
+private:
+    struct Request {
+        float deadline;
+        TileKey key;
+    };
+
+    float tileSize;
+    float originX;
+    float originZ;
+    float minHeight;
+    float maxHeight;
+    Generator generator;
+
+    // Camera motion, smoothed over about SMOOTHING seconds
+    static constexpr float SMOOTHING = 0.2f;
+    bool tracking = false;
+    float lastTime = 0.0f;
+    glm::vec3 lastPosition;
+    float lastYaw = 0.0f;
+    float lastPitch = 0.0f;
+    glm::vec3 velocity = glm::vec3(0.0f);
+    float yawRate = 0.0f;   // degrees per second
+    float pitchRate = 0.0f;
+
+    // Everything below is guarded by mutex
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::vector<Request> queue; // heap, earliest deadline on top
+    std::unordered_map<TileKey, float, TileKeyHash> pending;
+    std::unordered_set<TileKey, TileKeyHash> inFlight;
+    std::unordered_map<TileKey, std::shared_ptr<const QuantizedHeightMap>, TileKeyHash> resident;
+    std::unordered_set<TileKey, TileKeyHash> wasVisible;
+    std::vector<TileKey> visibleTiles;
+    std::vector<TileKey> completed;
+    std::vector<TileKey> evicted;
+    Stats stats;
+    std::vector<std::thread> workers;
+
+    static bool laterDeadline(const Request& a, const Request& b) {
+        return a.deadline > b.deadline;
+    }
+
+    void trackMotion(const Camera& camera, float time) {
+        float dt = time - lastTime;
+        if (tracking && dt > 0.0f) {
+            float blend = 1.0f - std::exp(-dt / SMOOTHING);
+            velocity = velocity + ((camera.Position - lastPosition) / dt - velocity) * blend;
+            yawRate += ((camera.Yaw - lastYaw) / dt - yawRate) * blend;
+            pitchRate += ((camera.Pitch - lastPitch) / dt - pitchRate) * blend;
+        }
+        tracking = true;
+        lastTime = time;
+        lastPosition = camera.Position;
+        lastYaw = camera.Yaw;
+        lastPitch = camera.Pitch;
+    }
+
+    glm::mat4 predictedViewProjection(const Camera& camera, float t, float aspect, float nearPlane, float farPlane) const {
+        glm::vec3 position = camera.Position + velocity * t;
+        float yaw = glm::radians(camera.Yaw + yawRate * t);
+        float pitch = glm::radians(std::min(std::max(camera.Pitch + pitchRate * t, -89.0f), 89.0f));
+        // as in Camera::updateCameraVectors
+        glm::vec3 front = glm::normalize(glm::vec3(std::cos(yaw) * std::cos(pitch), std::sin(pitch), std::sin(yaw) * std::cos(pitch)));
+        glm::vec3 right = glm::normalize(glm::cross(front, camera.WorldUp));
+        glm::vec3 up = glm::normalize(glm::cross(right, front));
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), aspect, nearPlane, farPlane);
+        return projection * glm::lookAt(position, position + front, up);
+    }
+
+    static float distanceTo(const glm::vec3& point, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+        float dx = std::max(std::max(boxMin.x - point.x, point.x - boxMax.x), 0.0f);
+        float dz = std::max(std::max(boxMin.z - point.z, point.z - boxMax.z), 0.0f);
+        return std::sqrt(dx * dx + dz * dz);
+    }
+
+    // Hit or miss for each tile entering the frustum (a missing one is queued with the earliest deadline)
+    void countVisibility(const std::vector<TileKey>& nowVisible) {
+        std::unordered_set<TileKey, TileKeyHash> visibleSet(nowVisible.begin(), nowVisible.end());
+        for (const TileKey& key : nowVisible) {
+            if (!wasVisible.count(key)) {
+                if (resident.count(key)) {
+                    stats.hits++;
+                }
+                else {
+                    stats.misses++;
+                }
+            }
+        }
+        wasVisible.swap(visibleSet);
+    }
+
+    void work() {
+        for (;;) {
+            TileKey key;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (stopping) {
+                    return;
+                }
+                std::pop_heap(queue.begin(), queue.end(), laterDeadline);
+                key = queue.back().key;
+                queue.pop_back();
+                pending.erase(key);
+                inFlight.insert(key);
+            }
+
+            std::shared_ptr<const QuantizedHeightMap> tile = std::make_shared<QuantizedHeightMap>(generator(key.x, key.z));
+
+            std::lock_guard<std::mutex> lock(mutex);
+            inFlight.erase(key);
+            resident[key] = tile;
+            completed.push_back(key);
+            stats.generated++;
+        }
+    }
+};
+
+#endif
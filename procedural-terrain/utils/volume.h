@@ -0,0 +1,389 @@
+#ifndef VOLUME_H
+#define VOLUME_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include "perlin.h"
+
+
+// A density field over a box of samples: solid where density > 0
+struct VolumeSettings {
+    int width = 400;            // samples along x
+    int height = 128;           // samples along y (up)
+    int length = 400;           // samples along z
+    float voxelSize = 0.2f;     // world distance between samples, as the height map's grid
+    float gridSize = 400.0f;    // samples per noise period at the lowest octave, as generateHeightMap's grid_size
+    float groundLevel = 50.0f;  // sample row where the density's vertical falloff crosses zero
+    float falloff = 40.0f;      // samples over which the falloff drops by one (the fBm's amplitude)
+    int octaves = 6;
+    int brickSize = 16;         // cells per brick side
+};
+
+
+// Triangle list: xyz per vertex (world space), three indices per triangle
+struct VolumeMesh {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    size_t bricks = 0;          // bricks in the volume
+    size_t surfaceBricks = 0;   // bricks that were meshed
+
+    size_t vertexCount() const { return vertices.size() / 3; }
+    size_t triangleCount() const { return indices.size() / 3; }
+};
+
+
+/*
+* 3D terrain with overhangs and caves: density = (groundLevel - y) / falloff + fBm(x, y, z), from
+* Perlin::noise in three dimensions rather than pinned to one plane as in heightAt().
+
+The volume is cut into bricks of brickSize cells. Interval bounds on the density (Perlin::noiseBounds
+per octave, the falloff is linear) find the bricks that can hold surface, subdividing from the whole
+volume so solid or empty regions are dropped in large pieces. Only those bricks are ever sampled.
+
+Each surface brick is meshed with surface nets on its own thread: one vertex per cell the surface
+crosses, at the mean of the crossings on the cell's edges, and a quad around every crossed edge. A
+brick owns the cells and edges whose lower corner lies in it, so quads only reach into the bricks
+below it on each axis; the cells they need are found in those bricks' upper faces when the bricks are
+joined, so every vertex is shared and stored once. Apart from per-thread scratch for one brick, memory
+is the brick list and the mesh, both in proportion to the surface rather than the volume.
+*/
+class DensityVolume {
+public:
+    explicit DensityVolume(const VolumeSettings& settings) : settings(settings) {
+        if (settings.width < 2 || settings.height < 2 || settings.length < 2 || settings.brickSize < 1) {
+            throw std::runtime_error("Density volume needs at least 2 samples per axis and bricks of a cell or more");
+        }
+        samples[0] = settings.width;
+        samples[1] = settings.height;
+        samples[2] = settings.length;
+        for (int a = 0; a < 3; a++) {
+            bricks[a] = (samples[a] - 2) / settings.brickSize + 1; // covers cells [0, samples - 1)
+        }
+    }
+
+    // Density at sample (i, j, k)
+    float density(int i, int j, int k) const {
+        const double scale = 1.0 / settings.gridSize;
+        double value = (settings.groundLevel - j) / settings.falloff;
+        double freq = scale, amp = 1.0;
+        for (int o = 0; o < settings.octaves; o++) {
+            value += Perlin::noise(i * freq, j * freq, k * freq) * amp;
+            freq *= 2.0;
+            amp /= 1.7;
+        }
+        return static_cast<float>(value);
+    }
+
+    // Bounds of the density over the samples from (i0, j0, k0) to (i1, j1, k1) inclusive
+    void densityBounds(int i0, int j0, int k0, int i1, int j1, int k1, double& lo, double& hi) const {
+        const double scale = 1.0 / settings.gridSize;
+        lo = (settings.groundLevel - j1) / settings.falloff;
+        hi = (settings.groundLevel - j0) / settings.falloff;
+        double freq = scale, amp = 1.0;
+        for (int o = 0; o < settings.octaves; o++) {
+            double noiseLo, noiseHi;
+            Perlin::noiseBounds(i0 * freq, j0 * freq, k0 * freq, i1 * freq, j1 * freq, k1 * freq, noiseLo, noiseHi);
+            lo += noiseLo * amp;
+            hi += noiseHi * amp;
+            freq *= 2.0;
+            amp /= 1.7;
+        }
+    }
+
+    // Meshes every brick the surface may cross. threads = 0 uses every hardware thread.
+    VolumeMesh mesh(int threads = 0) const {
+        std::vector<Brick> surface;
+        const int all[3] = { 0, 0, 0 };
+        findSurfaceBricks(all, bricks, surface);
+
+        if (threads <= 0) {
+            threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        }
+        threads = static_cast<int>(std::max<size_t>(1, std::min<size_t>(threads, surface.size())));
+        std::vector<BrickMesh> meshes(surface.size());
+        std::atomic<size_t> next(0);
+        auto work = [&]() {
+            Scratch scratch(settings.brickSize);
+            for (size_t b = next++; b < surface.size(); b = next++) {
+                meshBrick(surface[b], scratch, meshes[b]);
+            }
+        };
+        runThreads(threads, work);
+
+        return join(surface, meshes, threads);
+    }
+
+private:
+    struct Brick { int x, y, z; };
+
+    // One brick's share of the mesh before joining
+    struct BrickMesh {
+        std::vector<float> vertices;
+        std::vector<uint32_t> corners;          // four per quad: a vertex of this brick, or EXTERNAL | index into external
+        std::vector<uint64_t> external;         // cells of lower bricks, as global cell indices
+        std::vector<uint64_t> faceCells;        // (cell within the brick << 32 | vertex) for cells on the upper faces, sorted
+    };
+
+    struct Scratch {
+        std::vector<float> density;             // (brickSize + 1)^3 samples
+        std::vector<int> vertex;                // brickSize^3 cells, -1 where the surface does not cross
+
+        explicit Scratch(int brickSize)
+            : density(static_cast<size_t>(brickSize + 1) * (brickSize + 1) * (brickSize + 1)),
+              vertex(static_cast<size_t>(brickSize) * brickSize * brickSize) {}
+    };
+
+    static const uint32_t EXTERNAL = 0x80000000u;
+
+    VolumeSettings settings;
+    int samples[3];
+    int bricks[3];
+
+    template <typename Fn>
+    static void runThreads(int threads, Fn work) {
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Bricks [lo, hi) whose density bounds straddle zero, halving the larger side until single bricks
+    void findSurfaceBricks(const int* lo, const int* hi, std::vector<Brick>& out) const {
+        const int B = settings.brickSize;
+        int s0[3], s1[3];
+        for (int a = 0; a < 3; a++) {
+            s0[a] = lo[a] * B;
+            s1[a] = std::min(hi[a] * B, samples[a] - 1);
+        }
+        double dLo, dHi;
+        densityBounds(s0[0], s0[1], s0[2], s1[0], s1[1], s1[2], dLo, dHi);
+        // solid is density > 0; the margin covers rounding in the bounds
+        const double margin = 1e-9;
+        if (dLo > margin || dHi <= -margin) {
+            return;
+        }
+        int axis = 0;
+        for (int a = 1; a < 3; a++) {
+            if (hi[a] - lo[a] > hi[axis] - lo[axis]) {
+                axis = a;
+            }
+        }
+        if (hi[axis] - lo[axis] == 1) {
+            out.push_back({ lo[0], lo[1], lo[2] });
+            return;
+        }
+        int mid[3] = { hi[0], hi[1], hi[2] };
+        mid[axis] = (lo[axis] + hi[axis]) / 2;
+        findSurfaceBricks(lo, mid, out);
+        int upper[3] = { lo[0], lo[1], lo[2] };
+        upper[axis] = mid[axis];
+        findSurfaceBricks(upper, hi, out);
+    }
+
+    void meshBrick(const Brick& brick, Scratch& scratch, BrickMesh& out) const {
+        const int B = settings.brickSize, S = B + 1;
+        const int origin[3] = { brick.x * B, brick.y * B, brick.z * B };
+        // samples and cells of this brick that exist in the volume
+        int sampleCount[3], cellCount[3];
+        for (int a = 0; a < 3; a++) {
+            sampleCount[a] = std::min(S, samples[a] - origin[a]);
+            cellCount[a] = sampleCount[a] - 1;
+        }
+        auto sampleIndex = [S](int i, int j, int k) { return (static_cast<size_t>(k) * S + j) * S + i; };
+        auto cellIndex = [B](int i, int j, int k) { return (static_cast<size_t>(k) * B + j) * B + i; };
+
+        float* d = scratch.density.data();
+        for (int k = 0; k < sampleCount[2]; k++) {
+            for (int j = 0; j < sampleCount[1]; j++) {
+                for (int i = 0; i < sampleCount[0]; i++) {
+                    d[sampleIndex(i, j, k)] = density(origin[0] + i, origin[1] + j, origin[2] + k);
+                }
+            }
+        }
+
+        // a vertex in every cell with corners on both sides of the surface
+        std::fill(scratch.vertex.begin(), scratch.vertex.end(), -1);
+        for (int k = 0; k < cellCount[2]; k++) {
+            for (int j = 0; j < cellCount[1]; j++) {
+                for (int i = 0; i < cellCount[0]; i++) {
+                    float corner[8];
+                    int solid = 0;
+                    for (int c = 0; c < 8; c++) {
+                        corner[c] = d[sampleIndex(i + (c & 1), j + ((c >> 1) & 1), k + (c >> 2))];
+                        solid += corner[c] > 0.0f;
+                    }
+                    if (solid == 0 || solid == 8) {
+                        continue;
+                    }
+                    float sum[3] = { 0.0f, 0.0f, 0.0f };
+                    int crossings = 0;
+                    for (int c = 0; c < 8; c++) {
+                        for (int a = 0; a < 3; a++) {
+                            int other = c | (1 << a);
+                            if (other == c || (corner[c] > 0.0f) == (corner[other] > 0.0f)) {
+                                continue;
+                            }
+                            float t = corner[c] / (corner[c] - corner[other]);
+                            for (int b = 0; b < 3; b++) {
+                                sum[b] += ((c >> b) & 1) + (b == a ? t : 0.0f);
+                            }
+                            crossings++;
+                        }
+                    }
+                    const int cell[3] = { i, j, k };
+                    scratch.vertex[cellIndex(i, j, k)] = static_cast<int>(out.vertices.size() / 3);
+                    for (int b = 0; b < 3; b++) {
+                        out.vertices.push_back(toWorld(b, origin[b] + cell[b] + sum[b] / crossings));
+                    }
+                    if (i == B - 1 || j == B - 1 || k == B - 1) {
+                        out.faceCells.push_back(static_cast<uint64_t>(cellIndex(i, j, k)) << 32 | scratch.vertex[cellIndex(i, j, k)]);
+                    }
+                }
+            }
+        }
+
+        // A quad around every crossed edge whose lower sample is in this brick, joining the four cells
+        // that share it. The cells step back along the other two axes u, v (cyclic after the edge's
+        // axis), so corners in the order (-1,-1), (0,-1), (0,0), (-1,0) wind counter-clockwise about +axis.
+        const int du[4] = { -1, 0, 0, -1 }, dv[4] = { -1, -1, 0, 0 };
+        for (int k = 0; k < std::min(B, sampleCount[2]); k++) {
+            for (int j = 0; j < std::min(B, sampleCount[1]); j++) {
+                for (int i = 0; i < std::min(B, sampleCount[0]); i++) {
+                    const int local[3] = { i, j, k };
+                    const bool inside = d[sampleIndex(i, j, k)] > 0.0f;
+                    for (int a = 0; a < 3; a++) {
+                        const int u = (a + 1) % 3, v = (a + 2) % 3;
+                        const int g[3] = { origin[0] + i, origin[1] + j, origin[2] + k };
+                        // the edge must exist, and so must all four cells around it
+                        if (local[a] + 1 >= sampleCount[a] || g[u] < 1 || g[u] > samples[u] - 2 || g[v] < 1 || g[v] > samples[v] - 2) {
+                            continue;
+                        }
+                        int next[3] = { i, j, k };
+                        next[a]++;
+                        if (inside == (d[sampleIndex(next[0], next[1], next[2])] > 0.0f)) {
+                            continue;
+                        }
+                        uint32_t quad[4];
+                        for (int q = 0; q < 4; q++) {
+                            int cell[3] = { i, j, k };
+                            cell[u] += du[q];
+                            cell[v] += dv[q];
+                            if (cell[u] >= 0 && cell[v] >= 0) {
+                                quad[q] = static_cast<uint32_t>(scratch.vertex[cellIndex(cell[0], cell[1], cell[2])]);
+                            }
+                            else {
+                                quad[q] = EXTERNAL | static_cast<uint32_t>(out.external.size());
+                                out.external.push_back(static_cast<uint64_t>(globalCell(origin[0] + cell[0], origin[1] + cell[1], origin[2] + cell[2])));
+                            }
+                        }
+                        // outward is from solid to empty: +axis when the lower sample is solid
+                        if (inside) {
+                            out.corners.insert(out.corners.end(), { quad[0], quad[1], quad[2], quad[3] });
+                        }
+                        else {
+                            out.corners.insert(out.corners.end(), { quad[0], quad[3], quad[2], quad[1] });
+                        }
+                    }
+                }
+            }
+        }
+        std::sort(out.faceCells.begin(), out.faceCells.end());
+    }
+
+    VolumeMesh join(const std::vector<Brick>& surface, std::vector<BrickMesh>& meshes, int threads) const {
+        VolumeMesh result;
+        result.bricks = static_cast<size_t>(bricks[0]) * bricks[1] * bricks[2];
+        result.surfaceBricks = surface.size();
+
+        // where each brick's vertices and triangles go
+        std::vector<size_t> vertexBase(meshes.size() + 1, 0), indexBase(meshes.size() + 1, 0);
+        std::unordered_map<uint64_t, size_t> brickAt;
+        for (size_t b = 0; b < meshes.size(); b++) {
+            vertexBase[b + 1] = vertexBase[b] + meshes[b].vertices.size() / 3;
+            indexBase[b + 1] = indexBase[b] + meshes[b].corners.size() / 4 * 6;
+            brickAt[brickKey(surface[b].x, surface[b].y, surface[b].z)] = b;
+        }
+        if (vertexBase.back() > EXTERNAL) {
+            throw std::runtime_error("Density volume mesh has too many vertices for 32-bit indices");
+        }
+        result.vertices.resize(vertexBase.back() * 3);
+        result.indices.resize(indexBase.back());
+
+        std::atomic<size_t> next(0);
+        auto work = [&]() {
+            for (size_t b = next++; b < meshes.size(); b = next++) {
+                BrickMesh& mesh = meshes[b];
+                std::copy(mesh.vertices.begin(), mesh.vertices.end(), result.vertices.begin() + vertexBase[b] * 3);
+                // cells in lower bricks -> their vertex in the joined mesh
+                std::vector<uint32_t> resolved(mesh.external.size());
+                for (size_t e = 0; e < mesh.external.size(); e++) {
+                    resolved[e] = resolve(mesh.external[e], brickAt, meshes, vertexBase);
+                }
+                unsigned int* dst = result.indices.data() + indexBase[b];
+                for (size_t q = 0; q < mesh.corners.size(); q += 4) {
+                    uint32_t v[4];
+                    for (int c = 0; c < 4; c++) {
+                        uint32_t corner = mesh.corners[q + c];
+                        v[c] = (corner & EXTERNAL) ? resolved[corner & ~EXTERNAL] : static_cast<uint32_t>(vertexBase[b] + corner);
+                    }
+                    const unsigned int triangles[6] = { v[0], v[1], v[2], v[0], v[2], v[3] };
+                    dst = std::copy(triangles, triangles + 6, dst);
+                }
+                // done with this brick
+                std::vector<float>().swap(mesh.vertices);
+                std::vector<uint32_t>().swap(mesh.corners);
+                std::vector<uint64_t>().swap(mesh.external);
+            }
+        };
+        runThreads(threads, work);
+        return result;
+    }
+
+    // Joined vertex of a cell in another brick. Its brick is a surface brick: the edge that led here
+    // is one of the cell's, and crosses the surface.
+    uint32_t resolve(uint64_t global, const std::unordered_map<uint64_t, size_t>& brickAt,
+        const std::vector<BrickMesh>& meshes, const std::vector<size_t>& vertexBase) const {
+        const int B = settings.brickSize;
+        const int cells[3] = { samples[0] - 1, samples[1] - 1, samples[2] - 1 };
+        const int cell[3] = { static_cast<int>(global % cells[0]), static_cast<int>(global / cells[0] % cells[1]),
+            static_cast<int>(global / cells[0] / cells[1]) };
+        auto it = brickAt.find(brickKey(cell[0] / B, cell[1] / B, cell[2] / B));
+        if (it != brickAt.end()) {
+            const std::vector<uint64_t>& face = meshes[it->second].faceCells;
+            const uint64_t local = (static_cast<uint64_t>(cell[2] % B) * B + cell[1] % B) * B + cell[0] % B;
+            auto entry = std::lower_bound(face.begin(), face.end(), local << 32);
+            if (entry != face.end() && (*entry >> 32) == local) {
+                return static_cast<uint32_t>(vertexBase[it->second] + (*entry & 0xffffffffu));
+            }
+        }
+        throw std::runtime_error("Density volume surface crosses a brick that was not meshed");
+    }
+
+    size_t globalCell(int i, int j, int k) const {
+        return (static_cast<size_t>(k) * (samples[1] - 1) + j) * (samples[0] - 1) + i;
+    }
+
+    static uint64_t brickKey(int x, int y, int z) {
+        return static_cast<uint64_t>(x) | static_cast<uint64_t>(y) << 21 | static_cast<uint64_t>(z) << 42;
+    }
+
+    // Sample coordinate along axis to world, centred on the origin in x and z like the height map
+    float toWorld(int axis, float sample) const {
+        if (axis == 1) {
+            return sample * settings.voxelSize;
+        }
+        return (sample - samples[axis] / 2.0f) * settings.voxelSize;
+    }
+};
+
+#endif
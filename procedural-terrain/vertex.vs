@@ -1,13 +1,30 @@
 #version 330 core
 layout(location = 0) in vec3 aPos;
+layout(location = 1) in float aHeight; // quantized mode: normalized uint16 height
 //layout(location = 1) in vec2 aTexCoords;
 
 uniform mat4 projection;
 uniform mat4 view;
+uniform mat4 model;
+
+// Quantized mode: XZ is rebuilt from the sample index, height = aHeight * heightScale + heightOffset
+uniform bool quantized;
+uniform int gridWidth;
+uniform int gridLength;
+uniform float heightScale;
+uniform float heightOffset;
 
 
 //out vec2 TexCoords;
 
 void main() {
-	gl_Position = projection * view * vec4(aPos, 1.0);    //TexCoords = aTexCoords;
+	vec3 pos = aPos;
+	if (quantized) {
+		int i = gl_VertexID / gridWidth;
+		int j = gl_VertexID - i * gridWidth;
+		pos = vec3((float(i) - float(gridLength) / 2.0) / 5.0,
+			aHeight * heightScale + heightOffset,
+			(float(j) - float(gridWidth) / 2.0) / 5.0);
+	}
+	gl_Position = projection * view * model * vec4(pos, 1.0);    //TexCoords = aTexCoords;
 }
\ No newline at end of file